@@ -0,0 +1,74 @@
+// ===================================================================================
+// Bench Firmware of the LCD1602 Driver (make bench)
+// ===================================================================================
+//
+// Runs headless in ucsim (s51 -t 8052), driven by tools/bench.py. Each bench stores
+// the cycles of its call in bench_cycles[], in the order of BENCH_NAMES in the
+// makefile, and bench_done() is where the simulator stops to dump them.
+//
+// ucsim counts the machine cycles of a classic 8051 and so does its Timer2, i.e.
+// the numbers are exact for the simulated core and comparable between builds, but
+// not the 1T cycles of a real CH55x. DLY_us() counts the same Timer2, so its bench
+// shows the call overhead on this core, not its accuracy on hardware.
+
+#include "../src/config.h"
+#include "../src/system.h"
+#include "../src/delay.h"
+#include "../src/i2c.h"
+#include "../src/lcd1602.h"
+
+#define BENCH_MAX 16
+
+__xdata __at(0x0000) volatile uint32_t bench_cycles[BENCH_MAX]; // below XRAM_LOC
+static volatile uint16_t bench_hi;  // Timer2 overflows
+
+void BENCH_interrupt(void) __interrupt(INT_NO_TMR2) {
+  TF2 = 0;
+  bench_hi++;
+}
+
+// 32-bit Timer2 count, the overflow interrupt extends DLY_count()
+static uint32_t bench_now(void) {
+  uint16_t hi, lo;
+  do {
+    hi = bench_hi;
+    lo = DLY_count();
+  } while(hi != bench_hi);
+  return ((uint32_t)hi << 16) | lo;
+}
+
+#define BENCH(i, call) do {                         \
+  uint32_t _t = bench_now();                        \
+  call;                                             \
+  bench_cycles[i] = bench_now() - _t;               \
+} while(0)
+
+void bench_done(void) {             // breakpoint of tools/bench.py
+  while(1);
+}
+
+static const uint8_t smile[8] = {0x00, 0x0A, 0x0A, 0x00, 0x11, 0x0E, 0x00, 0x00};
+
+void main(void) {
+  CLK_config();
+  DLY_init();
+  ET2 = 1;
+  EA  = 1;
+  TICK_init();
+  i2clcd_init(4, 20);               // LCD2004, so that 80 chars fill the screen
+  DLY_ms(5);                        // let the clear of the init pass
+
+  BENCH(0, );                       // cost of the measurement itself
+  BENCH(1, i2clcd_putstr("0123456789ABCDEF"));
+  BENCH(2, i2clcd_putstr("0123456789ABCDEFGHIJ" "KLMNOPQRSTUVWXYZabcd"
+                         "efghijklmnopqrstuvwx" "yz0123456789ABCDEFGH"));
+  BENCH(3, i2clcd_custom_char(0, smile));
+  BENCH(4, I2C_write(0x55));
+  BENCH(5, i2clcd_clear());         // returns on the busy deadline, see _hal_wait()
+  DLY_ms(5);
+  BENCH(6, DLY_us(1));
+  BENCH(7, DLY_us(10));
+  BENCH(8, DLY_us(100));
+  BENCH(9, DLY_us(1000));
+  bench_done();
+}
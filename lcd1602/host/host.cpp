@@ -0,0 +1,163 @@
+// ===================================================================================
+// Host Mock of the CH551, CH552 and CH554 SFR Layer                          * v1.0 *
+// ===================================================================================
+
+#include <vector>
+#include "ch554_host.h"
+#include "ch554.h"
+#include "systick.h"
+
+static uint8_t  host_reg[256];          // SFR file
+static uint8_t  host_low[2];            // P1, P3 pins held low from outside
+static uint32_t host_cyc;               // Fsys cycles
+static uint64_t host_ps;                // virtual time in ps
+static uint32_t host_cyc_ps;            // ps per Fsys cycle
+static uint32_t host_t2;                // cycle count when Timer2 was started
+static std::vector<HOST_EDGE> host_log;
+
+static const uint32_t host_fsys[8] = {
+  187500, 750000, 3000000, 6000000, 12000000, 16000000, 24000000, 32000000
+};
+
+static void host_clock(uint8_t cfg) {
+  host_cyc_ps = (uint32_t)(1000000000000ULL / host_fsys[cfg & MASK_SYS_CK_SEL]);
+}
+
+// ===================================================================================
+// Virtual Clock
+// ===================================================================================
+void host_reset(void) {
+  uint8_t i;
+  memset(host_reg, 0, sizeof(host_reg));
+  host_reg[0x90] = 0xFF;                // port latches are high after reset
+  host_reg[0xB0] = 0xFF;
+  host_low[0] = host_low[1] = 0;
+  for(i = 0; i < 8 && host_fsys[i] != F_CPU; i++);
+  host_reg[0xB9] = 0x80 | (i & 7);      // CLOCK_CFG as set by CLK_config()
+  host_clock(host_reg[0xB9]);
+  host_cyc = 0;
+  host_ps  = 0;
+  host_t2  = 0;
+  host_log.clear();
+}
+
+void host_spend(uint16_t cycles) {
+  host_cyc += cycles;
+  host_ps  += (uint64_t)cycles * host_cyc_ps;
+}
+
+void host_asm(const char *s) {
+  if(!strncmp(s, "nop", 3))       host_spend(1);
+  else if(!strncmp(s, "sjmp", 4)) host_spend(4);
+  else                            host_spend(3);
+}
+
+uint64_t host_ns(void)     { return host_ps / 1000; }
+uint32_t host_cycles(void) { return host_cyc; }
+
+// ===================================================================================
+// Pin Transitions
+// ===================================================================================
+uint32_t host_edges(void) { return host_log.size(); }
+
+const HOST_EDGE *host_edge(uint32_t i) {
+  return i < host_log.size() ? &host_log[i] : NULL;
+}
+
+void host_pull_low(uint8_t port, uint8_t mask) {
+  host_low[port == 3] = mask;
+}
+
+static void host_port(uint8_t port, uint8_t old, uint8_t val) {
+  uint8_t b, diff = old ^ val;
+  for(b = 0; b < 8; b++) {
+    if(diff & (1 << b)) {
+      HOST_EDGE e = {host_ns(), (uint8_t)((port == 3 ? 8 : 0) + b), (uint8_t)((val >> b) & 1)};
+      host_log.push_back(e);
+    }
+  }
+}
+
+void host_dump_vcd(FILE *f) {
+  uint16_t used = 0;
+  uint8_t  p;
+  uint64_t t = ~0ULL;
+  for(const HOST_EDGE &e : host_log) used |= 1 << e.pin;
+  fprintf(f, "$timescale 1ns $end\n$scope module ch55x $end\n");
+  for(p = 0; p < 16; p++)
+    if(used & (1 << p)) fprintf(f, "$var wire 1 %c P%d%d $end\n", 'a' + p, p < 8 ? 1 : 3, p & 7);
+  fprintf(f, "$upscope $end\n$enddefinitions $end\n#0\n");
+  for(p = 0; p < 16; p++)
+    if(used & (1 << p)) fprintf(f, "1%c\n", 'a' + p);
+  for(const HOST_EDGE &e : host_log) {
+    if(e.ns != t) fprintf(f, "#%llu\n", (unsigned long long)(t = e.ns));
+    fprintf(f, "%d%c\n", e.level, 'a' + e.pin);
+  }
+}
+
+// ===================================================================================
+// SFR Access
+// ===================================================================================
+uint8_t host_sfr_read(uint8_t addr) {
+  uint16_t t2;
+  host_spend(1);
+  switch(addr) {
+    case 0x90: return host_reg[addr] & ~host_low[0];     // P1
+    case 0xB0: return host_reg[addr] & ~host_low[1];     // P3
+    case 0xCC:                                           // TL2
+    case 0xCD:                                           // TH2
+      t2 = (host_reg[0xC8] & 0x04) ? (uint16_t)(host_cyc - host_t2) : 0;
+      return addr == 0xCC ? (uint8_t)t2 : (uint8_t)(t2 >> 8);
+    case 0xC3:                                           // TKEY_CTRL, 1ms timer
+      return (host_reg[addr] & ~bTKC_IF) | (host_ps % 1000000000ULL < 500000000ULL ? bTKC_IF : 0);
+  }
+  return host_reg[addr];
+}
+
+void host_sfr_write(uint8_t addr, uint8_t val) {
+  uint8_t old = host_reg[addr];
+  host_spend(1);
+  host_reg[addr] = val;
+  switch(addr) {
+    case 0x90: host_port(1, old, val); break;
+    case 0xB0: host_port(3, old, val); break;
+    case 0xB9: host_clock(val); break;
+    case 0xC8:                                           // T2CON: TR2 starts Timer2
+      if((val & ~old) & 0x04) host_t2 = host_cyc;
+      break;
+  }
+}
+
+// ===================================================================================
+// System Tick on the Virtual Clock (systick.c needs the Timer0 interrupt)
+// ===================================================================================
+void TICK_init(void) {}
+
+uint32_t millis(void) {
+  host_spend(20);                       // about the cost of the real call
+  return (uint32_t)(host_ps / 1000000000ULL);
+}
+
+uint32_t micros(void) {
+  host_spend(40);
+  return (uint32_t)(host_ps / 1000000ULL);
+}
+
+void TICK_sleep(uint16_t ms) {
+  host_ps += (uint64_t)ms * 1000000000ULL;
+}
+
+deadline_t deadline_set(uint16_t ms) {
+  return millis() + ms + 1;
+}
+
+uint8_t deadline_expired(deadline_t deadline) {
+  return (int32_t)(millis() - deadline) >= 0;
+}
+
+void TICK_rescale(uint16_t t, uint8_t cp4) {
+  (void)t;
+  (void)cp4;
+}
+
+void TICK_interrupt(void) {}
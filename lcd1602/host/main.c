@@ -0,0 +1,47 @@
+// ===================================================================================
+// Host Run of the LCD1602 Driver (make host)
+// ===================================================================================
+//
+// Runs the driver against the mock SFR layer and prints the bus activity. With a
+// file name as argument, the pin transitions are written there as a value change
+// dump (e.g. for GTKWave).
+
+#include "../src/config.h"
+#include "../src/lcd1602.h"
+#include "../src/i2c.h"
+
+int main(int argc, char **argv)
+{
+  uint64_t t;
+  FILE *f;
+
+  host_reset();
+  TICK_init();
+  i2clcd_init(2, 16);
+  printf("i2clcd_init:        %8llu ns, %6u transitions\n",
+         (unsigned long long)host_ns(), host_edges());
+
+  t = host_ns();
+  i2clcd_putstr("Hello from host!");
+  printf("i2clcd_putstr(16):  %8llu ns\n", (unsigned long long)(host_ns() - t));
+
+  t = host_ns();
+  i2clcd_clear();
+  printf("i2clcd_clear:       %8llu ns\n", (unsigned long long)(host_ns() - t));
+
+  printf("total:              %8llu ns, %6u transitions, %u cycles\n",
+         (unsigned long long)host_ns(), host_edges(), host_cycles());
+
+  if (argc > 1)
+  {
+    f = fopen(argv[1], "w");
+    if (!f)
+    {
+      perror(argv[1]);
+      return 1;
+    }
+    host_dump_vcd(f);
+    fclose(f);
+  }
+  return 0;
+}
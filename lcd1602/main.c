@@ -57,38 +57,68 @@
 #include "src/gpio.h"    // for GPIO
 #include "src/delay.h"   // for delays
 #include "src/lcd1602.h" // for lcd1602
+#include "src/sched.h"   // task scheduler
+#include "src/prof.h"    // cycle profiler
 
 // ===================================================================================
 // Main Function
 // ===================================================================================
 
-void main(void)
+// Demo sequence, a protothread polled every 10ms
+static void demo(void)
 {
-  // Setup
-  CLK_config(); // configure system clock
-  DLY_ms(5);    // wait for clock to stabilize
+  static uint8_t i;
+  static char t[2];
+#ifdef PROF_ENABLE
+  static char p[17];
+#endif
 
-  i2clcd_init(2, 16);
+  TASK_BEGIN();
   while (1)
   {
     i2clcd_putstr("I2C LCD Tutorial");
-    DLY_ms(2000);
+    TASK_SLEEP(2000);
     i2clcd_clear();
     i2clcd_putstr("Lets Count 0-10!");
-    DLY_ms(2000);
+    TASK_SLEEP(2000);
     i2clcd_clear();
-    for (int i = 0; i <= 10; ++i)
+    for (i = 0; i <= 10; ++i)
     {
-      char t[2];
       t[0] = '0' + i;
       t[1] = '\0';
       i2clcd_putstr(i == 10 ? "10" : t);
       i2clcd_backlight_on();
-      DLY_ms(1000);
+      TASK_SLEEP(1000);
       i2clcd_backlight_off();
-      DLY_ms(2000);
+      TASK_SLEEP(2000);
       i2clcd_clear();
     }
     i2clcd_backlight_on();
+#ifdef PROF_ENABLE
+    PROF_line(PROF_LCD_DATA, p); // average/maximum cycles of a character
+    i2clcd_putstr(p);
+    PROF_line(PROF_I2C_WRITE, p); // and of an I2C byte
+    i2clcd_putstr(p);
+    TASK_SLEEP(3000);
+    i2clcd_clear();
+#endif
   }
+  TASK_END();
+}
+
+__code const SCHED_TASK tasks[] = {
+    {demo, 10}, // demo sequence
+};
+
+void main(void)
+{
+  // Setup
+  CLK_config(); // configure system clock
+  DLY_ms(5);    // wait for clock to stabilize
+
+  PROF_init(); // no-op without PROF_ENABLE
+  TICK_init(); // command deadlines of the LCD, enables the interrupts
+  i2clcd_init(2, 16);
+  SCHED_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+  SCHED_run();
 }
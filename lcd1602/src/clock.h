@@ -0,0 +1,77 @@
+// ===================================================================================
+// System Clock Scaling for CH551, CH552 and CH554                            * v1.0 *
+// ===================================================================================
+//
+// CLK_config() sets Fsys to F_CPU at boot, CLK_set() switches it at runtime, e.g. to
+// 750kHz or 3MHz while idle and to 24MHz for display bursts:
+//
+//   CLK_set(CLK_24MHZ);              // burst (FREQ_MAX = 24000000)
+//   lcd_update();
+//   CLK_set(CLK_750KHZ);             // idle
+//
+// DLY_us(), millis()/micros() and the loop delays of the additional I2C buses follow
+// CLK_sel and CLK_cp4 at runtime. Each switch keeps the millisecond tick, losing less
+// than 4us. Delays inlined at compile time (I2C_DELAY_H/L of the default bus,
+// DLY_us_const(), the TM1637 bit delay) are sized for F_MAX, the highest clock the
+// firmware switches to (FREQ_MAX in the makefile, default F_CPU). They are minimums,
+// the bus runs slower at lower clocks. The Timer1 engines of the TM1637 (async
+// flush, dimming) are sized for F_CPU and slow down with the clock. 187.5kHz is not
+// selectable, it is left to DLY_sleep_ms(), and F_CPU must be 750kHz or higher.
+// CLK_set() ignores selections above CLK_MAX, the clock of F_MAX.
+
+#pragma once
+#include <stdint.h>
+#include "ch554.h"
+
+#ifndef F_MAX
+#define F_MAX F_CPU                 // highest Fsys set by CLK_set()
+#endif
+
+#define CLK_750KHZ  1               // CLOCK_CFG clock selections
+#define CLK_3MHZ    2
+#define CLK_6MHZ    3
+#define CLK_12MHZ   4
+#define CLK_16MHZ   5
+#define CLK_24MHZ   6
+#define CLK_32MHZ   7
+
+#if   F_CPU == 32000000
+  #define CLK_BOOT  CLK_32MHZ       // selection of CLK_config()
+#elif F_CPU == 24000000
+  #define CLK_BOOT  CLK_24MHZ
+#elif F_CPU == 16000000
+  #define CLK_BOOT  CLK_16MHZ
+#elif F_CPU == 12000000
+  #define CLK_BOOT  CLK_12MHZ
+#elif F_CPU == 6000000
+  #define CLK_BOOT  CLK_6MHZ
+#elif F_CPU == 3000000
+  #define CLK_BOOT  CLK_3MHZ
+#else
+  #define CLK_BOOT  CLK_750KHZ
+#endif
+#define CLK_BOOT_CP4 ((uint8_t)(F_CPU / 250000))
+
+#if   F_MAX >= 32000000
+  #define CLK_MAX   CLK_32MHZ       // highest selection of CLK_set()
+#elif F_MAX >= 24000000
+  #define CLK_MAX   CLK_24MHZ
+#elif F_MAX >= 16000000
+  #define CLK_MAX   CLK_16MHZ
+#elif F_MAX >= 12000000
+  #define CLK_MAX   CLK_12MHZ
+#elif F_MAX >= 6000000
+  #define CLK_MAX   CLK_6MHZ
+#elif F_MAX >= 3000000
+  #define CLK_MAX   CLK_3MHZ
+#else
+  #define CLK_MAX   CLK_750KHZ
+#endif
+#if CLK_BOOT > CLK_MAX
+  #error F_MAX (FREQ_MAX) must not be lower than F_CPU
+#endif
+
+extern __data uint8_t CLK_sel;      // current clock selection (CLK_...)
+extern __data uint8_t CLK_cp4;      // Fsys cycles per 4us (1ms = 250 * CLK_cp4)
+
+void CLK_set(uint8_t sel);          // switch Fsys, keep the system tick
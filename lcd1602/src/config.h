@@ -9,6 +9,28 @@
 #define PIN_SDA             P16       // I2C SDA
 #define PIN_SCL             P17       // I2C SCL
 
+// Additional I2C buses (optional, see i2c.h)
+//#define PIN_SDA1            P14       // I2C bus 1 SDA
+//#define PIN_SCL1            P15       // I2C bus 1 SCL
+//#define I2C1_KHZ            100       // I2C bus 1 clock in kHz
+
+// Parallel I2C buses sharing PIN_SCL (optional, see i2c.h)
+//#define I2C_PAR_PORT        1         // port of the SDA pins (1 or 3)
+//#define I2C_PAR_SDA_MASK    0x0F      // SDA pins P10-P13 -> 4 buses, the LCD driver
+                                        // then writes to a panel on each of them
+
+// I2C trace (optional, see i2c.h)
+//#define I2C_TRACE                     // record transactions and bus statistics
+//#define I2C_TRACE_SIZE      16        // number of recorded transactions
+
+// Scheduler
+//#define SCHED_SLEEP                   // idle at 187.5kHz between the tasks
+//#define SCHED_CLK_IDLE    CLK_750KHZ  // clock while waiting for a task
+//#define SCHED_CLK_BURST   CLK_24MHZ   // clock of the tasks (FREQ_MAX = 24000000)
+
+// Profiler
+//#define PROF_ENABLE                   // cycle counts of the library functions (prof.h)
+
 // USB device descriptor
 #define USB_VENDOR_ID       0x16C0    // VID (shared www.voti.nl)
 #define USB_PRODUCT_ID      0x27DD    // PID (shared CDC)
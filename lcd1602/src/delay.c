@@ -1,70 +1,113 @@
 // ===================================================================================
-// Delay Functions for CH551, CH552 and CH554                                 * v1.1 *
+// Delay Functions for CH551, CH552 and CH554                                 * v1.3 *
 // ===================================================================================
 
 #include "delay.h"
+#include "system.h"
 
 // ===================================================================================
 // Delay in Units of us
 // ===================================================================================
-void DLY_us(uint16_t n) {           // delay in us
-  #ifdef F_CPU
-    #if F_CPU <= 6000000
-      n >>= 2;
-    #endif
-    #if F_CPU <= 3000000
-      n >>= 2;
-    #endif
-    #if F_CPU <= 750000
-      n >>= 4;
-    #endif
-  #endif
+#define DLY_US_CHUNK  500                           // us per wait, < 65536 cycles
 
-  while(n) {                        // total = 12~13 Fsys cycles, 1uS @Fsys=12MHz
-    __asm__("inc _SAFE_MOD");       // 2 Fsys cycles, for higher Fsys, add operation here
-    #ifdef F_CPU
-      #if F_CPU >= 14000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 16000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 18000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 20000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 22000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 24000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 26000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 28000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 30000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-      #if F_CPU >= 32000000
-        __asm__("inc _SAFE_MOD");
-      #endif
-    #endif
-    --n;
+// Fsys cycles of n < DLY_US_CHUNK us at the current clock
+#define DLY_CYCLES(n) (CLK_cp4 ? (uint16_t)((n) * CLK_cp4) >> 2 : (uint16_t)((n) * 3) >> 4)
+
+void DLY_init(void) {               // start Timer2 as free running Fsys counter
+  if(TR2) return;
+  T2MOD |= bTMR_CLK | bT2_CLK;
+  T2CON  = 0;
+  RCAP2  = 0;
+  TR2    = 1;
+}
+
+// read the running Timer2 consistently (TL2 may carry into TH2 between the reads),
+// also called by the profiler probes in interrupts, so the locals are not overlayed
+#pragma save
+#pragma nooverlay
+uint16_t DLY_count(void) {
+  uint8_t h, l;
+  do {
+    h = TH2;
+    l = TL2;
+  } while(h != TH2);
+  return (h << 8) | l;
+}
+#pragma restore
+
+void DLY_us(uint16_t n) {           // delay in us
+  uint16_t start, cycles;
+  if(!TR2) DLY_init();
+  start = DLY_count();
+  while(n >= DLY_US_CHUNK) {        // long waits in chunks, without drift
+    cycles = DLY_CYCLES(DLY_US_CHUNK);
+    while((uint16_t)(DLY_count() - start) < cycles);
+    start += cycles;
+    n -= DLY_US_CHUNK;
   }
+  cycles = DLY_CYCLES(n);
+  if(cycles <= DLY_US_OVERHEAD) return;
+  cycles -= DLY_US_OVERHEAD;
+  while((uint16_t)(DLY_count() - start) < cycles);
 }
 
 // ===================================================================================
 // Delay in Units of ms
 // ===================================================================================
 void DLY_ms(uint16_t n) {           // delay in ms
+  #ifdef DLY_NO_TKEY                // simulators without the touch-key timer (make bench)
+  while(n--) DLY_us(1000);
+  #else
   while(n) {
     while(!(TKEY_CTRL & bTKC_IF));
     while(TKEY_CTRL & bTKC_IF);
     --n;
   }
+  #endif
+}
+
+// ===================================================================================
+// Low-Power Delay in Units of ms
+// ===================================================================================
+void DLY_sleep_ms(uint16_t n) {     // returns right after the n-th 1ms tick
+  uint8_t cfg = CLOCK_CFG;
+  uint8_t sel = CLK_sel;
+  uint8_t cp4 = CLK_cp4;
+  __critical {
+    SAFE_MOD  = 0x55;
+    SAFE_MOD  = 0xAA;               // enter safe mode
+    CLOCK_CFG = cfg & ~MASK_SYS_CK_SEL;  // Fsys = 187.5kHz
+    SAFE_MOD  = 0x00;               // terminate safe mode
+    CLK_sel = 0;                    // DLY_us() in interrupts scales to 187.5kHz,
+    CLK_cp4 = 0;                    // CLK_set() leaves the clock alone meanwhile
+  }
+  while(n) {                        // the touch-key timer does not depend on Fsys
+    while(!(TKEY_CTRL & bTKC_IF));
+    while(TKEY_CTRL & bTKC_IF);
+    --n;
+  }
+  __critical {
+    SAFE_MOD  = 0x55;
+    SAFE_MOD  = 0xAA;
+    CLOCK_CFG = cfg;                // back to the configured clock
+    SAFE_MOD  = 0x00;
+    CLK_sel = sel;
+    CLK_cp4 = cp4;
+  }
+}
+
+// ===================================================================================
+// Power Down until a Wake-Up Event
+// ===================================================================================
+void DLY_sleep_until(uint8_t source) {
+  uint8_t wake = WAKE_CTRL;         // sources enabled by the application stay
+  SAFE_MOD  = 0x55;
+  SAFE_MOD  = 0xAA;                 // WAKE_CTRL is write protected
+  WAKE_enable(source);
+  SAFE_MOD  = 0x00;
+  SLEEP_now();                      // PD is cleared by the wake-up
+  SAFE_MOD  = 0x55;
+  SAFE_MOD  = 0xAA;
+  WAKE_CTRL = wake;
+  SAFE_MOD  = 0x00;
 }
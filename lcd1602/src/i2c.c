@@ -11,12 +11,19 @@
 // PIN_SCL - pin connected to serial clock of the I2C bus
 // External pull-up resistors (4k7 - 10k) are mandatory!
 //
+// The bit engine of every bus is expanded from i2c_engine.h with its own pins and
+// timing. Additional buses are enabled with PIN_SDA1/PIN_SCL1 (clock I2C1_KHZ) and
+// PIN_SDA2/PIN_SCL2 (clock I2C2_KHZ) in config.h.
+//
 // Further information:     https://github.com/wagiminator/ATtiny13-TinyOLEDdemo
 // 2022 by Stefan Wagner:   https://github.com/wagiminator
 
 #include "i2c.h"
 #include "gpio.h"
 #include "config.h"
+#include "clock.h"
+#include "delay.h"
+#include "prof.h"
 
 // ===================================================================================
 // I2C Delay
@@ -24,21 +31,22 @@
 // (for 400kHz devices -> SCL low: min 1300us, SCL high: min 600us)
 // The exact number of clock cycles required for jumps and thus also loops cannot
 // be precisely predicted. However, this can be accepted for this type of
-// application (synchronous data transmission).
-#if F_CPU >= 24000000 // ~500kHz I2C clock
+// application (synchronous data transmission). The delays are sized for F_MAX, the
+// highest clock set by CLK_set(), the bus is slower at lower clocks.
+#if F_MAX >= 24000000 // ~500kHz I2C clock
 #define I2C_DELAY_H()  \
   __asm__("sjmp .+2"); \
   ++SAFE_MOD // delay 6-7 clock cycles
 #define I2C_DELAY_L()  \
   __asm__("sjmp .+2"); \
   ++SAFE_MOD                                          // delay 6-7 clock cycles
-#elif F_CPU >= 16000000                               // ~500kHz I2C clock
+#elif F_MAX >= 16000000                               // ~500kHz I2C clock
 #define I2C_DELAY_H() __asm__("sjmp .+2")             // delay 4-5 clock cycles
 #define I2C_DELAY_L()                                 // no delay
-#elif F_CPU >= 12000000                               // ~360kHz I2C clock
+#elif F_MAX >= 12000000                               // ~360kHz I2C clock
 #define I2C_DELAY_H() __asm__("orl _SAFE_MOD, #0x00") // delay 3 clock cycles
 #define I2C_DELAY_L()                                 // no delay
-#elif F_CPU >= 6000000                                // ~200kHz I2C clock
+#elif F_MAX >= 6000000                                // ~200kHz I2C clock
 #define I2C_DELAY_H() __asm__("nop")                  // delay 1 clock cycle
 #define I2C_DELAY_L()                                 // no delay
 #else                                                 // ~100kHz I2C clock
@@ -46,19 +54,43 @@
 #define I2C_DELAY_L()                                 // no delay
 #endif
 
+// Delay loop for the additional buses (about 4 clock cycles per loop). The loop
+// counts are looked up for the current clock (CLK_sel) when the bus runs. One SCL
+// period spends four delays of the same count, two while LOW and two while HIGH
+// (see I2C_E_CLOCKOUT), plus about 32 clock cycles for the bit handling.
+#define I2C_LOOPS_AT(f, khz) \
+  ((f) / 1000 / (khz) > 32 ? ((f) / 1000 / (khz) - 32) / 16 : 0)
+#define I2C_LOOPS(khz) I2C_LOOPS_AT(F_MAX, khz)
+#define I2C_LOOPS_SAT(f, khz) \
+  (I2C_LOOPS_AT(f, khz) > 255 ? 255 : I2C_LOOPS_AT(f, khz))
+#define I2C_LOOP_TABLE(khz)                                                   \
+  {0, I2C_LOOPS_SAT(750000, khz), I2C_LOOPS_SAT(3000000, khz),                \
+   I2C_LOOPS_SAT(6000000, khz), I2C_LOOPS_SAT(12000000, khz),                 \
+   I2C_LOOPS_SAT(16000000, khz), I2C_LOOPS_SAT(24000000, khz),                \
+   I2C_LOOPS_SAT(32000000, khz)}
+#define I2C_LOOP_DELAY(n) \
+  {                       \
+    uint8_t d = (n);      \
+    while (d--)           \
+      DLY_LOOP();         \
+  }
+
 // ===================================================================================
 // I2C Pin Macros
 // ===================================================================================
 
 // Check pin defines
-#ifndef PIN_SDA
-#error PIN_SDA is undefinded
+#if defined(PIN_SDA) != defined(PIN_SCL)
+#error PIN_SDA and PIN_SCL must be defined together
 #endif
-#ifndef PIN_SCL
-#error PIN_SCL is undefined
+#if defined(PIN_SDA1) != defined(PIN_SCL1)
+#error PIN_SDA1 and PIN_SCL1 must be defined together
+#endif
+#if defined(PIN_SDA2) != defined(PIN_SCL2)
+#error PIN_SDA2 and PIN_SCL2 must be defined together
 #endif
 
-// I2C macros
+// I2C macros of the default bus
 #define I2C_SDA_HIGH() PIN_high(PIN_SDA) // release SDA -> pulled HIGH by resistor
 #define I2C_SDA_LOW() PIN_low(PIN_SDA)   // SDA LOW     -> pulled LOW  by MCU
 #define I2C_SCL_HIGH() PIN_high(PIN_SCL) // release SCL -> pulled HIGH by resistor
@@ -72,83 +104,357 @@
   I2C_SCL_LOW()
 
 // ===================================================================================
-// I2C Functions
+// I2C Trace
 // ===================================================================================
+// With I2C_TRACE defined in config.h every transaction (START to STOP) is recorded
+// into the XRAM ring buffer I2C_trace_buf together with the bus statistics in
+// I2C_trace_stats. Timestamps are taken from Timer2, which runs freely at Fsys.
+// Stamps and durations are 16-bit counts: they wrap every 65536 Fsys cycles (4ms at
+// 16MHz), so only durations below that are valid and stamps give the order of
+// transactions close together, not an absolute time.
+#ifdef I2C_TRACE
+
+#ifndef I2C_TRACE_SIZE
+#define I2C_TRACE_SIZE 16 // number of entries, must be a power of 2
+#endif
+#if I2C_TRACE_SIZE & (I2C_TRACE_SIZE - 1) || I2C_TRACE_SIZE > 128
+#error I2C_TRACE_SIZE must be a power of 2 up to 128
+#endif
+
+__xdata I2C_TRACE_ENTRY I2C_trace_buf[I2C_TRACE_SIZE]; // recorded transactions
+__xdata I2C_TRACE_STATS I2C_trace_stats;              // bus statistics
+__xdata uint8_t I2C_trace_head;                       // total number of entries
+static __xdata uint8_t I2C_trace_open;                // 1: in transaction, 2: address pending
 
-// I2C init function
-void I2C_init(void)
+// The open transaction is recorded in place, it is committed by advancing the head
+#define I2C_trace_cur I2C_trace_buf[I2C_trace_head & (I2C_TRACE_SIZE - 1)]
+
+#define I2C_TRACE_INIT() I2C_trace_init()
+#define I2C_TRACE_START(bus, addr) I2C_trace_start(bus, addr)
+#define I2C_TRACE_WRITE(nack) I2C_trace_write(nack)
+#define I2C_TRACE_READ() I2C_trace_write(0)
+#define I2C_TRACE_STOP() I2C_trace_stop()
+
+// Start Timer2 as free running Fsys counter
+static void I2C_trace_init(void)
 {
-  PIN_output_OD(PIN_SDA); // set SDA pin to open-drain OUTPUT
-  PIN_output_OD(PIN_SCL); // set SCL pin to open-drain OUTPUT
-  PIN_write(PIN_SDA, 1);  // added for lcd1602
-  PIN_write(PIN_SCL, 1);  // added for lcd1602
+  if (TR2)
+    return;
+  T2MOD |= bTMR_CLK | bT2_CLK; // Timer2 clock = Fsys
+  T2CON = 0;                   // 16-bit auto reload, timer mode
+  RCAP2 = 0;                   // reload with 0 -> full 16-bit range
+  TR2 = 1;                     // run
 }
 
-// I2C transmit one data byte to the slave, ignore ACK bit, no clock stretching allowed
-void I2C_write(uint8_t data)
+// Close the open transaction and store it in the ring buffer
+static void I2C_trace_close(void)
 {
-  uint8_t i;
-  for (i = 8; i; i--, data <<= 1)
-  {                                                     // transmit 8 bits, MSB first
-    (data & 0x80) ? (I2C_SDA_HIGH()) : (I2C_SDA_LOW()); // SDA HIGH if bit is 1
-    I2C_CLOCKOUT();                                     // clock out -> slave reads the bit
-  }
+  I2C_trace_cur.cycles = T2COUNT - I2C_trace_cur.stamp;
+  I2C_trace_head++;
+  I2C_trace_open = 0;
+}
 
-  I2C_SDA_HIGH(); // release SDA for ACK bit of slave
-  I2C_DELAY_H();  // delay
-  I2C_DELAY_H();  // delay
-  I2C_CLOCKOUT(); // 9th clock pulse is for the ignored ACK bit
+// STOP condition: close the open transaction
+static void I2C_trace_stop(void)
+{
+  if (!I2C_trace_open)
+    return;
+  I2C_trace_close();
+  I2C_trace_stats.clocks++; // STOP condition
+  I2C_trace_stats.conditions++;
 }
 
-// I2C start transmission
-void I2C_start(uint8_t addr)
+// Open a new transaction (a restart closes the previous one without a STOP)
+static void I2C_trace_start(uint8_t bus, uint8_t addr)
 {
-  I2C_SDA_LOW();   // start condition: SDA goes LOW first
-  I2C_DELAY_H();   // delay
-  I2C_SCL_LOW();   // start condition: SCL goes LOW second
-  I2C_DELAY_H();   // delay ?????
-  I2C_write(addr); // send slave address
+  if (I2C_trace_open)
+    I2C_trace_close();
+  I2C_trace_cur.stamp = T2COUNT;
+  I2C_trace_cur.bus = bus;
+  I2C_trace_cur.addr = addr;
+  I2C_trace_cur.count = 0;
+  I2C_trace_cur.nack = 0;
+  I2C_trace_stats.clocks++; // START condition
+  I2C_trace_stats.conditions++;
+  I2C_trace_stats.transactions++;
+  I2C_trace_open = 2;
 }
 
-// I2C restart transmission
-void I2C_restart(uint8_t addr)
+// Record one transmitted or received byte
+static void I2C_trace_write(uint8_t nack)
 {
-  I2C_SDA_HIGH();  // prepare SDA for HIGH to LOW transition
-  I2C_DELAY_H();   // delay
-  I2C_SCL_HIGH();  // restart condition: clock HIGH
-  I2C_start(addr); // start again
+  I2C_trace_stats.clocks += 9;
+  if (nack)
+    I2C_trace_cur.nack++;
+  if (I2C_trace_open == 2)
+  { // first byte after START is the address
+    I2C_trace_stats.overhead++;
+    I2C_trace_open = 1;
+  }
+  else
+  {
+    I2C_trace_stats.payload++;
+    I2C_trace_cur.count++;
+  }
 }
 
-// I2C stop transmission
-void I2C_stop(void)
+// Output helper for I2C_trace_dump()
+static void I2C_trace_hex(void (*out)(char), uint32_t val, uint8_t digits)
 {
-  I2C_SDA_LOW();  // prepare SDA for LOW to HIGH transition
-  I2C_DELAY_H();  // delay
-  I2C_SCL_HIGH(); // stop condition: SCL goes HIGH first
-  I2C_DELAY_H();  // delay
-  I2C_SDA_HIGH(); // stop condition: SDA goes HIGH second
+  uint8_t nibble;
+  while (digits--)
+  {
+    nibble = (val >> (digits << 2)) & 0x0f;
+    out(nibble < 10 ? '0' + nibble : 'A' - 10 + nibble);
+  }
 }
 
-// I2C receive one data byte from the slave (ack=0 for last byte, ack>0 if more bytes to follow)
-uint8_t I2C_read(uint8_t ack)
+// Clear the ring buffer and the statistics
+void I2C_trace_reset(void)
 {
   uint8_t i;
-  uint8_t data = 0; // variable for the received byte
-  I2C_SDA_HIGH();   // release SDA -> will be toggled by slave
-  for (i = 8; i; i--)
-  {                 // receive 8 bits
-    data <<= 1;     // bits shifted in right (MSB first)
-    I2C_DELAY_H();  // delay
-    I2C_DELAY_L();  // delay
-    I2C_SCL_HIGH(); // clock HIGH
-    if (I2C_SDA_READ())
-      data |= 1;   // read bit
-    I2C_SCL_LOW(); // clock LOW -> slave prepares next bit
+  uint8_t __xdata *p = (uint8_t __xdata *)&I2C_trace_stats;
+  for (i = sizeof(I2C_trace_stats); i; i--)
+    *p++ = 0;
+  I2C_trace_head = 0;
+  I2C_trace_open = 0;
+}
+
+// Print statistics and the ring buffer (oldest entry first) as hex text lines:
+// "S <clocks> <payload> <overhead> <conditions> <transactions>"
+// "T <bus> <stamp> <cycles> <addr> <count> <nack>"
+void I2C_trace_dump(void (*out)(char))
+{
+  uint8_t i, n;
+  __xdata I2C_TRACE_ENTRY *e;
+
+  out('S');
+  out(' ');
+  I2C_trace_hex(out, I2C_trace_stats.clocks, 8);
+  out(' ');
+  I2C_trace_hex(out, I2C_trace_stats.payload, 8);
+  out(' ');
+  I2C_trace_hex(out, I2C_trace_stats.overhead, 8);
+  out(' ');
+  I2C_trace_hex(out, I2C_trace_stats.conditions, 8);
+  out(' ');
+  I2C_trace_hex(out, I2C_trace_stats.transactions, 4);
+  out('\n');
+
+  n = I2C_trace_head < I2C_TRACE_SIZE ? I2C_trace_head : I2C_TRACE_SIZE;
+  for (i = I2C_trace_head - n; n; n--, i++)
+  {
+    e = &I2C_trace_buf[i & (I2C_TRACE_SIZE - 1)];
+    out('T');
+    out(' ');
+    I2C_trace_hex(out, e->bus, 1);
+    out(' ');
+    I2C_trace_hex(out, e->stamp, 4);
+    out(' ');
+    I2C_trace_hex(out, e->cycles, 4);
+    out(' ');
+    I2C_trace_hex(out, e->addr, 2);
+    out(' ');
+    I2C_trace_hex(out, e->count, 2);
+    out(' ');
+    I2C_trace_hex(out, e->nack, 2);
+    out('\n');
   }
-  if (ack)
-    I2C_SDA_LOW(); // pull SDA LOW to acknowledge (ACK)
-  I2C_DELAY_H();   // delay
-  I2C_DELAY_H();   // delay
-  I2C_CLOCKOUT();  // clock out -> slave reads ACK bit
-  return data;     // return the received byte
 }
+
+#else
+#define I2C_TRACE_INIT()
+#define I2C_TRACE_START(bus, addr)
+#define I2C_TRACE_WRITE(nack)
+#define I2C_TRACE_READ()
+#define I2C_TRACE_STOP()
+#endif // I2C_TRACE
+
+// ===================================================================================
+// I2C Functions
+// ===================================================================================
+
+// Default bus: I2C_init(), I2C_start(), ... on PIN_SDA/PIN_SCL
+#ifdef PIN_SDA
+#define I2C_E_SDA PIN_SDA
+#define I2C_E_SCL PIN_SCL
+#define I2C_E_FN(name) I2C_##name
+#define I2C_E_ID 0
+#define I2C_E_DELAY_H() I2C_DELAY_H()
+#define I2C_E_DELAY_L() I2C_DELAY_L()
+#include "i2c_engine.h"
+__code const I2C_BUS I2C_bus0 = {I2C_init, I2C_start, I2C_restart, I2C_stop, I2C_write, I2C_read};
+#endif
+
+// Bus 1: I2C1_init(), I2C1_start(), ... on PIN_SDA1/PIN_SCL1
+#ifdef PIN_SDA1
+#ifndef I2C1_KHZ
+#define I2C1_KHZ 100
+#endif
+#if I2C_LOOPS(I2C1_KHZ) > 255
+#error I2C1_KHZ is too low for this F_MAX
+#endif
+#define I2C_E_SDA PIN_SDA1
+#define I2C_E_SCL PIN_SCL1
+#define I2C_E_FN(name) I2C1_##name
+#define I2C_E_ID 1
+static __code const uint8_t I2C1_loops[8] = I2C_LOOP_TABLE(I2C1_KHZ);
+#define I2C_E_DELAY_H() I2C_LOOP_DELAY(I2C1_loops[CLK_sel])
+#define I2C_E_DELAY_L()                  \
+  I2C_LOOP_DELAY(I2C1_loops[CLK_sel]); \
+  I2C_LOOP_DELAY(I2C1_loops[CLK_sel])
+#include "i2c_engine.h"
+__code const I2C_BUS I2C_bus1 = {I2C1_init, I2C1_start, I2C1_restart, I2C1_stop, I2C1_write, I2C1_read};
+#endif
+
+// Bus 2: I2C2_init(), I2C2_start(), ... on PIN_SDA2/PIN_SCL2
+#ifdef PIN_SDA2
+#ifndef I2C2_KHZ
+#define I2C2_KHZ 100
+#endif
+#if I2C_LOOPS(I2C2_KHZ) > 255
+#error I2C2_KHZ is too low for this F_MAX
+#endif
+#define I2C_E_SDA PIN_SDA2
+#define I2C_E_SCL PIN_SCL2
+#define I2C_E_FN(name) I2C2_##name
+#define I2C_E_ID 2
+static __code const uint8_t I2C2_loops[8] = I2C_LOOP_TABLE(I2C2_KHZ);
+#define I2C_E_DELAY_H() I2C_LOOP_DELAY(I2C2_loops[CLK_sel])
+#define I2C_E_DELAY_L()                  \
+  I2C_LOOP_DELAY(I2C2_loops[CLK_sel]); \
+  I2C_LOOP_DELAY(I2C2_loops[CLK_sel])
+#include "i2c_engine.h"
+__code const I2C_BUS I2C_bus2 = {I2C2_init, I2C2_start, I2C2_restart, I2C2_stop, I2C2_write, I2C2_read};
+#endif
+
+// ===================================================================================
+// Parallel I2C Buses
+// ===================================================================================
+// All buses share PIN_SCL, each bus has its own SDA pin on port I2C_PAR_PORT. The
+// data bits of all buses are transposed into one port pattern per bit, so that each
+// bit is shifted out to every bus with a single port update. SDA changes are applied
+// with XRL on the port latch, which leaves the other pins of the port untouched.
+// Transactions are traced as bus 3 (I2C_PAR_ID), one entry for all buses; the NACK
+// count counts the bytes that at least one bus did not acknowledge.
+#ifdef I2C_PAR_SDA_MASK
+
+#ifndef PIN_SCL
+#error the parallel buses need PIN_SCL (and PIN_SDA) of the default bus
+#endif
+#define I2C_PAR_ID 3
+
+#if I2C_PAR_PORT == 1
+#define I2C_PAR_PX P1
+#define I2C_PAR_PX_MOD_OC P1_MOD_OC
+#define I2C_PAR_PX_DIR_PU P1_DIR_PU
+#elif I2C_PAR_PORT == 3
+#define I2C_PAR_PX P3
+#define I2C_PAR_PX_MOD_OC P3_MOD_OC
+#define I2C_PAR_PX_DIR_PU P3_DIR_PU
+#else
+#error I2C_PAR_PORT must be 1 or 3
+#endif
+
+// Parallel I2C macros
+#define I2C_PAR_SDA_HIGH() I2C_PAR_PX |= I2C_PAR_SDA_MASK  // release all SDA lines
+#define I2C_PAR_SDA_LOW() I2C_PAR_PX &= ~I2C_PAR_SDA_MASK  // pull all SDA lines LOW
+#define I2C_PAR_SDA_READ() (I2C_PAR_PX & I2C_PAR_SDA_MASK) // read all SDA lines
+
+static uint8_t I2C_par_planes[8]; // port pattern for each bit, MSB first
+static uint8_t I2C_par_sda;       // current state of the SDA lines
+
+// I2C transmit the prepared bit patterns to all buses, return NACK mask
+static uint8_t I2C_par_send(void)
+{
+  uint8_t i;
+  uint8_t nack;
+  PROF_BEGIN(PROF_I2C_WRITE);
+  for (i = 0; i < 8; i++)
+  {                                                // transmit 8 bits, MSB first
+    I2C_PAR_PX ^= I2C_par_sda ^ I2C_par_planes[i]; // update all SDA lines at once
+    I2C_par_sda = I2C_par_planes[i];               // remember the new line state
+    I2C_CLOCKOUT();                                // clock out -> slaves read the bit
+  }
+
+  I2C_PAR_SDA_HIGH(); // release SDA lines for ACK bit of slaves
+  I2C_par_sda = I2C_PAR_SDA_MASK;
+  I2C_DELAY_H();             // delay
+  I2C_DELAY_H();             // delay
+  I2C_DELAY_L();             // delay
+  I2C_SCL_HIGH();            // 9th clock pulse is for the ACK bit
+  I2C_DELAY_H();             // delay
+  nack = I2C_PAR_SDA_READ(); // a HIGH line means no slave acknowledged
+  I2C_DELAY_H();             // delay
+  I2C_SCL_LOW();             // clock LOW
+  I2C_TRACE_WRITE(nack);
+  PROF_END(PROF_I2C_WRITE);
+  return nack;
+}
+
+// Parallel I2C init function
+void I2C_par_init(void)
+{
+  I2C_PAR_PX_MOD_OC |= I2C_PAR_SDA_MASK;  // set SDA pins to open-drain OUTPUT
+  I2C_PAR_PX_DIR_PU &= ~I2C_PAR_SDA_MASK; // without pullup
+  I2C_PAR_SDA_HIGH();                     // release SDA lines
+  I2C_par_sda = I2C_PAR_SDA_MASK;
+  PIN_output_OD(PIN_SCL); // set SCL pin to open-drain OUTPUT
+  PIN_write(PIN_SCL, 1);  // release SCL
+  I2C_TRACE_INIT();       // start trace timestamps
+}
+
+// Parallel I2C transmit data[n] to bus n, return mask of the buses without ACK
+uint8_t I2C_par_write(const uint8_t *data)
+{
+  uint8_t i, bit, byte;
+  for (i = 0; i < 8; i++)
+    I2C_par_planes[i] = 0;
+  for (bit = 1; bit; bit <<= 1)
+  { // transpose: bit i of each byte goes to plane i
+    if (!(I2C_PAR_SDA_MASK & bit))
+      continue;
+    byte = *data++;
+    for (i = 0; i < 8; i++, byte <<= 1)
+    {
+      if (byte & 0x80)
+        I2C_par_planes[i] |= bit;
+    }
+  }
+  return I2C_par_send();
+}
+
+// Parallel I2C transmit the same byte to all buses, return mask of the buses without ACK
+uint8_t I2C_par_write_all(uint8_t data)
+{
+  uint8_t i;
+  for (i = 0; i < 8; i++, data <<= 1)
+    I2C_par_planes[i] = (data & 0x80) ? I2C_PAR_SDA_MASK : 0;
+  return I2C_par_send();
+}
+
+// Parallel I2C start transmission on all buses
+void I2C_par_start(uint8_t addr)
+{
+  I2C_PAR_SDA_LOW(); // start condition: SDA lines go LOW first
+  I2C_par_sda = 0;
+  I2C_DELAY_H();           // delay
+  I2C_SCL_LOW();           // start condition: SCL goes LOW second
+  I2C_DELAY_H();           // delay
+  I2C_TRACE_START(I2C_PAR_ID, addr);
+  I2C_par_write_all(addr); // send slave address to all buses
+}
+
+// Parallel I2C stop transmission on all buses
+void I2C_par_stop(void)
+{
+  I2C_PAR_SDA_LOW();  // prepare SDA lines for LOW to HIGH transition
+  I2C_DELAY_H();      // delay
+  I2C_SCL_HIGH();     // stop condition: SCL goes HIGH first
+  I2C_DELAY_H();      // delay
+  I2C_PAR_SDA_HIGH(); // stop condition: SDA lines go HIGH second
+  I2C_par_sda = I2C_PAR_SDA_MASK;
+  I2C_TRACE_STOP();
+}
+
+#endif // I2C_PAR_SDA_MASK
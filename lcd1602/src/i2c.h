@@ -6,11 +6,49 @@
 // I2C clock frequency is slower. ACK bit of the slave is ignored. Clock stretching 
 // by the slave is not allowed.
 //
-// PIN_SDA and PIN_SCL must be defined in config.h:
-// PIN_SDA - pin connected to serial data of the I2C bus
-// PIN_SCL - pin connected to serial clock of the I2C bus
+// Each bus is enabled by its pin macros in config.h, only the defined buses are
+// built. The pins of a bus must be defined together (checked at compile time):
+// PIN_SDA, PIN_SCL               - default bus (bus 0)
+// PIN_SDA1, PIN_SCL1             - bus 1, I2C1_KHZ optional
+// PIN_SDA2, PIN_SCL2             - bus 2, I2C2_KHZ optional
+// I2C_PAR_PORT, I2C_PAR_SDA_MASK - parallel buses, need PIN_SCL of the default bus
+// The LCD driver uses the default bus, or the parallel buses if they are defined,
+// so it needs PIN_SDA and PIN_SCL in either case.
 // External pull-up resistors (4k7 - 10k) are mandatory!
 //
+// Additional buses (optional):
+// Each bus gets its own bit engine specialized for its pins, so all buses run with
+// single-cycle pin access. Define in config.h:
+// PIN_SDA1, PIN_SCL1 - pins of bus 1, I2C1_KHZ - its clock in kHz (default 100)
+// PIN_SDA2, PIN_SCL2 - pins of bus 2, I2C2_KHZ - its clock in kHz (default 100)
+// Bus 1 is used with I2C1_start(), I2C1_write(), ... or through its instance
+// I2C_bus1, which allows drivers to select a bus at runtime:
+//   const I2C_BUS __code *bus = &I2C_bus1;
+//   I2C_BUS_start(bus, addr); I2C_BUS_write(bus, data); I2C_BUS_stop(bus);
+// I2C_bus0 is the instance of the default bus (PIN_SDA, PIN_SCL).
+//
+// Parallel buses (optional):
+// Up to 8 buses can share PIN_SCL, each one with its own SDA pin on the same port.
+// Every clock edge then shifts one bit to all buses at once, so identical slaves
+// with the same address (e.g. several PCF8574 LCD backpacks at 0x27) are updated
+// in the time of one. Define in config.h:
+// I2C_PAR_PORT     - port of the SDA pins (1 or 3)
+// I2C_PAR_SDA_MASK - bit mask of the SDA pins within that port
+// Bus n is the n-th set bit of I2C_PAR_SDA_MASK, counting from bit 0. The LCD
+// driver uses these buses instead of the default one when they are defined.
+//
+// Trace (optional):
+// With I2C_TRACE defined in config.h every transaction on the serial buses is
+// recorded into an XRAM ring buffer of I2C_TRACE_SIZE entries (default 16): bus
+// (0-2, 3 for the parallel buses as a whole), address, number of payload bytes,
+// number of bytes without ACK, Timer2 timestamp and duration in Fsys cycles. I2C_trace_stats counts SCL clocks (9 per byte, one
+// for each START and STOP), payload bytes, overhead (address) bytes and START/STOP
+// conditions. Protocol overhead in clocks = clocks - 9 * payload. Timer2 is started
+// as free running Fsys counter by the init function of the bus. Stamps and
+// durations are 16 bits wide and wrap after 65536 Fsys cycles (4ms at 16MHz).
+// The buffers can be read from a simulator (symbols I2C_trace_buf, I2C_trace_head,
+// I2C_trace_stats) or printed with I2C_trace_dump(putchar_function).
+//
 // Further information:     https://github.com/wagiminator/ATtiny13-TinyOLEDdemo
 // 2022 by Stefan Wagner:   https://github.com/wagiminator
 
@@ -23,3 +61,72 @@ void I2C_restart(uint8_t addr); // I2C restart transmission
 void I2C_stop(void);            // I2C stop transmission
 void I2C_write(uint8_t data);   // I2C transmit one data byte to the slave
 uint8_t I2C_read(uint8_t ack);  // I2C receive one data byte from the slave
+
+void I2C1_init(void);            // I2C bus 1 functions
+void I2C1_start(uint8_t addr);
+void I2C1_restart(uint8_t addr);
+void I2C1_stop(void);
+void I2C1_write(uint8_t data);
+uint8_t I2C1_read(uint8_t ack);
+
+void I2C2_init(void);            // I2C bus 2 functions
+void I2C2_start(uint8_t addr);
+void I2C2_restart(uint8_t addr);
+void I2C2_stop(void);
+void I2C2_write(uint8_t data);
+uint8_t I2C2_read(uint8_t ack);
+
+// I2C bus instance
+typedef struct
+{
+  void (*init)(void);
+  void (*start)(uint8_t addr);
+  void (*restart)(uint8_t addr);
+  void (*stop)(void);
+  void (*write)(uint8_t data);
+  uint8_t (*read)(uint8_t ack);
+} I2C_BUS;
+
+extern __code const I2C_BUS I2C_bus0; // default bus (PIN_SDA, PIN_SCL)
+extern __code const I2C_BUS I2C_bus1; // bus 1 (PIN_SDA1, PIN_SCL1)
+extern __code const I2C_BUS I2C_bus2; // bus 2 (PIN_SDA2, PIN_SCL2)
+
+#define I2C_BUS_init(bus) (bus)->init()
+#define I2C_BUS_start(bus, addr) (bus)->start(addr)
+#define I2C_BUS_restart(bus, addr) (bus)->restart(addr)
+#define I2C_BUS_stop(bus) (bus)->stop()
+#define I2C_BUS_write(bus, data) (bus)->write(data)
+#define I2C_BUS_read(bus, ack) (bus)->read(ack)
+
+void I2C_par_init(void);                     // parallel I2C init function
+void I2C_par_start(uint8_t addr);            // start transmission on all buses
+void I2C_par_stop(void);                     // stop transmission on all buses
+uint8_t I2C_par_write(const uint8_t *data);  // transmit data[n] to bus n, return NACK mask
+uint8_t I2C_par_write_all(uint8_t data);     // transmit the same byte to all buses
+
+// I2C trace entry and statistics (I2C_TRACE)
+typedef struct
+{
+  uint16_t stamp;  // Timer2 count at START (Fsys cycles)
+  uint16_t cycles; // duration from START to STOP (Fsys cycles)
+  uint8_t addr;    // address byte including R/W bit
+  uint8_t count;   // number of payload bytes
+  uint8_t nack;    // number of bytes without ACK
+  uint8_t bus;     // bus number
+} I2C_TRACE_ENTRY;
+
+typedef struct
+{
+  uint32_t clocks;       // SCL clock pulses including START and STOP
+  uint32_t payload;      // data bytes
+  uint32_t overhead;     // address bytes
+  uint32_t conditions;   // START and STOP conditions
+  uint16_t transactions; // number of transactions
+} I2C_TRACE_STATS;
+
+extern __xdata I2C_TRACE_ENTRY I2C_trace_buf[]; // ring buffer
+extern __xdata I2C_TRACE_STATS I2C_trace_stats; // statistics
+extern __xdata uint8_t I2C_trace_head;          // total number of recorded entries
+
+void I2C_trace_reset(void);               // clear ring buffer and statistics
+void I2C_trace_dump(void (*out)(char));   // print statistics and ring buffer
@@ -0,0 +1,137 @@
+// ===================================================================================
+// I2C Bit Engine Template for CH551, CH552 and CH554                         * v1.1 *
+// ===================================================================================
+//
+// This file is included by i2c.c once for every I2C bus. Each inclusion expands into
+// a complete set of bitbanging functions specialized for one pair of pins, so every
+// pin access still compiles to a single SETB/CLR instruction. Define before including:
+// I2C_E_SDA        - SDA pin of the bus (e.g. P16)
+// I2C_E_SCL        - SCL pin of the bus (e.g. P17)
+// I2C_E_FN(name)   - name of the generated functions (e.g. I2C_##name)
+// I2C_E_ID         - bus number recorded by the trace layer (I2C_TRACE)
+// I2C_E_DELAY_H()  - delay while SCL is HIGH
+// I2C_E_DELAY_L()  - delay while SCL is LOW
+// These defines are removed again at the end of this file.
+//
+// Simple I2C bitbanging, ACK bit of the slave is ignored. Clock stretching by the
+// slave is not allowed.
+
+// I2C macros
+#define I2C_E_SDA_HIGH() PIN_high(I2C_E_SDA) // release SDA -> pulled HIGH by resistor
+#define I2C_E_SDA_LOW() PIN_low(I2C_E_SDA)   // SDA LOW     -> pulled LOW  by MCU
+#define I2C_E_SCL_HIGH() PIN_high(I2C_E_SCL) // release SCL -> pulled HIGH by resistor
+#define I2C_E_SCL_LOW() PIN_low(I2C_E_SCL)   // SCL LOW     -> pulled LOW  by MCU
+#define I2C_E_SDA_READ() PIN_read(I2C_E_SDA) // read SDA pin
+#define I2C_E_CLOCKOUT() \
+  I2C_E_DELAY_L();       \
+  I2C_E_SCL_HIGH();      \
+  I2C_E_DELAY_H();       \
+  I2C_E_DELAY_H();       \
+  I2C_E_SCL_LOW()
+
+// I2C init function
+void I2C_E_FN(init)(void)
+{
+  PIN_output_OD(I2C_E_SDA); // set SDA pin to open-drain OUTPUT
+  PIN_output_OD(I2C_E_SCL); // set SCL pin to open-drain OUTPUT
+  PIN_write(I2C_E_SDA, 1);  // added for lcd1602
+  PIN_write(I2C_E_SCL, 1);  // added for lcd1602
+  I2C_TRACE_INIT();         // start trace timestamps
+}
+
+// I2C transmit one data byte to the slave, ignore ACK bit, no clock stretching allowed
+void I2C_E_FN(write)(uint8_t data)
+{
+  uint8_t i;
+  PROF_BEGIN(PROF_I2C_WRITE);
+  for (i = 8; i; i--, data <<= 1)
+  {                                                         // transmit 8 bits, MSB first
+    (data & 0x80) ? (I2C_E_SDA_HIGH()) : (I2C_E_SDA_LOW()); // SDA HIGH if bit is 1
+    I2C_E_CLOCKOUT();                                       // clock out -> slave reads the bit
+  }
+
+  I2C_E_SDA_HIGH(); // release SDA for ACK bit of slave
+  I2C_E_DELAY_H();  // delay
+  I2C_E_DELAY_H();  // delay
+#ifdef I2C_TRACE
+  I2C_E_DELAY_L();         // delay
+  I2C_E_SCL_HIGH();        // 9th clock pulse is for the ACK bit
+  I2C_E_DELAY_H();         // delay
+  I2C_E_DELAY_H();         // delay
+  i = I2C_E_SDA_READ();    // SDA HIGH -> not acknowledged
+  I2C_E_SCL_LOW();         // clock LOW
+  I2C_TRACE_WRITE(i);      // record byte and ACK result
+#else
+  I2C_E_CLOCKOUT(); // 9th clock pulse is for the ignored ACK bit
+#endif
+  PROF_END(PROF_I2C_WRITE);
+}
+
+// I2C start transmission
+void I2C_E_FN(start)(uint8_t addr)
+{
+  I2C_TRACE_START(I2C_E_ID, addr); // open trace entry
+  I2C_E_SDA_LOW();        // start condition: SDA goes LOW first
+  I2C_E_DELAY_H();        // delay
+  I2C_E_SCL_LOW();        // start condition: SCL goes LOW second
+  I2C_E_DELAY_H();        // delay ?????
+  I2C_E_FN(write)(addr);  // send slave address
+}
+
+// I2C restart transmission
+void I2C_E_FN(restart)(uint8_t addr)
+{
+  I2C_E_SDA_HIGH();       // prepare SDA for HIGH to LOW transition
+  I2C_E_DELAY_H();        // delay
+  I2C_E_SCL_HIGH();       // restart condition: clock HIGH
+  I2C_E_FN(start)(addr);  // start again
+}
+
+// I2C stop transmission
+void I2C_E_FN(stop)(void)
+{
+  I2C_E_SDA_LOW();  // prepare SDA for LOW to HIGH transition
+  I2C_E_DELAY_H();  // delay
+  I2C_E_SCL_HIGH(); // stop condition: SCL goes HIGH first
+  I2C_E_DELAY_H();  // delay
+  I2C_E_SDA_HIGH(); // stop condition: SDA goes HIGH second
+  I2C_TRACE_STOP(); // close trace entry
+}
+
+// I2C receive one data byte from the slave (ack=0 for last byte, ack>0 if more bytes to follow)
+uint8_t I2C_E_FN(read)(uint8_t ack)
+{
+  uint8_t i;
+  uint8_t data = 0; // variable for the received byte
+  I2C_E_SDA_HIGH(); // release SDA -> will be toggled by slave
+  for (i = 8; i; i--)
+  {                   // receive 8 bits
+    data <<= 1;       // bits shifted in right (MSB first)
+    I2C_E_DELAY_H();  // delay
+    I2C_E_DELAY_L();  // delay
+    I2C_E_SCL_HIGH(); // clock HIGH
+    if (I2C_E_SDA_READ())
+      data |= 1;     // read bit
+    I2C_E_SCL_LOW(); // clock LOW -> slave prepares next bit
+  }
+  if (ack)
+    I2C_E_SDA_LOW(); // pull SDA LOW to acknowledge (ACK)
+  I2C_E_DELAY_H();   // delay
+  I2C_E_DELAY_H();   // delay
+  I2C_E_CLOCKOUT();  // clock out -> slave reads ACK bit
+  I2C_TRACE_READ();  // record byte
+  return data;       // return the received byte
+}
+
+#undef I2C_E_SDA_HIGH
+#undef I2C_E_SDA_LOW
+#undef I2C_E_SCL_HIGH
+#undef I2C_E_SCL_LOW
+#undef I2C_E_SDA_READ
+#undef I2C_E_CLOCKOUT
+#undef I2C_E_SDA
+#undef I2C_E_SCL
+#undef I2C_E_FN
+#undef I2C_E_ID
+#undef I2C_E_DELAY_H
+#undef I2C_E_DELAY_L
@@ -1,6 +1,9 @@
 #include "lcd1602.h"
+#include "config.h"
 #include "i2c.h"
 #include "delay.h"
+#include "systick.h"
+#include "prof.h"
 
 #define _delay DLY_ms
 #define _hal_sleep_us DLY_us
@@ -8,6 +11,21 @@
 #define false 0
 #define I2C_ADDR (0x27 << 1)
 
+// With the parallel buses (I2C_PAR_SDA_MASK in config.h) the driver writes to all
+// panels at once: identical PCF8574 backpacks at I2C_ADDR, one per SDA pin, sharing
+// PIN_SCL, all show the same content in the time of one.
+#ifdef I2C_PAR_SDA_MASK
+#define _i2c_init I2C_par_init
+#define _i2c_start I2C_par_start
+#define _i2c_write I2C_par_write_all
+#define _i2c_stop I2C_par_stop
+#else
+#define _i2c_init I2C_init
+#define _i2c_start I2C_start
+#define _i2c_write I2C_write
+#define _i2c_stop I2C_stop
+#endif
+
 // # PCF8574 pin definitions
 enum
 {
@@ -52,15 +70,24 @@ static __xdata uint8_t m_cursor_y = 0;
 static __xdata uint8_t m_num_lines = 0;
 static __xdata uint8_t m_num_columns = 0;
 static __xdata uint8_t m_implied_newline = 0;
+static __xdata deadline_t m_ready; // the LCD accepts the next command
 
 static void _hal_write_init_nibble(const uint8_t nibble);
 static void _hal_write_command(const uint8_t cmd);
 
+/// @brief Wait until the LCD has completed the previous command. Slow commands
+///        set a deadline instead of waiting, so the caller can do other work.
+static void _hal_wait(void)
+{
+    while (!deadline_expired(m_ready))
+        ;
+}
+
 static void _write(const uint8_t v)
 {
-    I2C_start(I2C_ADDR);
-    I2C_write(v);
-    I2C_stop();
+    _i2c_start(I2C_ADDR);
+    _i2c_write(v);
+    _i2c_stop();
 }
 
 /// @brief  Writes an initialization nibble to the LCD.
@@ -77,7 +104,7 @@ static void _hal_write_init_nibble(const uint8_t nibble)
 /// @param cmd
 static void _hal_write_command(const uint8_t cmd)
 {
-
+    _hal_wait();
     uint8_t byte = ((m_backlight << SHIFT_BACKLIGHT) |
                     (((cmd >> 4) & 0x0f) << SHIFT_DATA));
     _write(byte | MASK_E);
@@ -91,7 +118,7 @@ static void _hal_write_command(const uint8_t cmd)
     if (cmd <= 3)
     {
         // The home and clear commands require a worst case delay of 4.1 msec
-        _delay(5);
+        m_ready = deadline_set(5);
     }
 }
 
@@ -99,6 +126,8 @@ static void _hal_write_command(const uint8_t cmd)
 /// @param data
 static void _hal_write_data(const uint8_t data)
 {
+    _hal_wait();
+    PROF_BEGIN(PROF_LCD_DATA);
     uint8_t byte = (MASK_RS |
                     (m_backlight << SHIFT_BACKLIGHT) |
                     (((data >> 4) & 0x0f) << SHIFT_DATA));
@@ -110,6 +139,7 @@ static void _hal_write_data(const uint8_t data)
             ((data & 0x0f) << SHIFT_DATA));
     _write(byte | MASK_E);
     _write(byte);
+    PROF_END(PROF_LCD_DATA);
 }
 
 /// @brief Allows the hal layer to turn the backlight on
@@ -282,9 +312,9 @@ void i2clcd_init(const uint8_t num_lines, const uint8_t num_columns)
     m_num_lines = num_lines > 4 ? 4 : num_lines;
     m_num_columns = num_columns > 40 ? 40 : num_columns;
 
-    I2C_init(); // initialize I2C first
+    _i2c_init(); // initialize I2C first
 
-    I2C_write(0);
+    _i2c_write(0);
     _delay(20); // Allow LCD time to powerup
 
     // Send reset 3 times
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <stdint.h>
+#include "systick.h" // the tick interrupt must be visible to main()
+
+// The command deadlines run on the 1ms tick: call TICK_init() (or SCHED_init(),
+// which calls it) before i2clcd_init(). TICK_init() enables the global interrupts.
 
 void i2clcd_init(const uint8_t num_lines, const uint8_t num_columns);
 void i2clcd_display_on(void);
@@ -10,4 +14,5 @@ void i2clcd_backlight_off(void);
 void i2clcd_clear(void);
 void i2clcd_hide_cursor(void);
 void i2clcd_blink_cursor_on(void);
-void i2clcd_putstr(const char *s);
\ No newline at end of file
+void i2clcd_putstr(const char *s);
+void i2clcd_custom_char(const int location, const uint8_t charmap[8]);
@@ -171,9 +171,11 @@ inline void RST_now(void) {
 // Bootloader (BOOT) Functions
 // ===================================================================================
 inline void BOOT_now(void) {
+  #ifdef __SDCC                     // no 8051 assembler in the host build (host/)
   __asm
     ljmp #BOOT_LOAD_ADDR
   __endasm;
+  #endif
 }
 
 inline void BOOT_prepare(void) {
@@ -0,0 +1,136 @@
+// ===================================================================================
+// System Tick Functions for CH551, CH552 and CH554                           * v1.1 *
+// ===================================================================================
+
+#include "systick.h"
+#include "delay.h"
+#include "clock.h"
+
+#define TICK_STOPPED 8                      // Fsys cycles the timer stops in the interrupt
+#define TICK_SWITCH  12                     // Fsys cycles the timer stops in TICK_rescale()
+
+static volatile uint32_t __data TICK_ms;    // ms since TICK_init()
+static uint16_t __data TICK_counts = F_CPU / 1000;          // Timer0 counts per ms
+static uint16_t __data TICK_reload = 65536 - F_CPU / 1000;  // Timer0 start value
+
+// ===================================================================================
+// Timer0 Interrupt: Count Milliseconds
+// ===================================================================================
+void TICK_interrupt(void) __interrupt(INT_NO_TMR0) {
+  uint16_t t;
+  TR0 = 0;                                  // add the reload to the counts elapsed
+  t  = TL0 | (TH0 << 8);                    // since the overflow
+  t += TICK_reload + TICK_STOPPED;
+  TL0 = (uint8_t)t;
+  TH0 = (uint8_t)(t >> 8);
+  TR0 = 1;
+  TICK_ms++;
+}
+
+// ===================================================================================
+// Start the Tick
+// ===================================================================================
+void TICK_init(void) {
+  if(TR0) return;                           // already running
+  TMOD  = (TMOD & 0xf0) | bT0_M0;           // Timer0 mode 1: 16-bit
+  T2MOD |= bTMR_CLK | bT0_CLK;              // Timer0 clock: Fsys
+  TL0   = (uint8_t)TICK_reload;
+  TH0   = (uint8_t)(TICK_reload >> 8);
+  ET0   = 1;                                // enable Timer0 interrupt
+  EA    = 1;                                // enable global interrupts
+  TR0   = 1;                                // start Timer0
+}
+
+// ===================================================================================
+// Time since Start
+// ===================================================================================
+uint32_t millis(void) {
+  uint32_t ms;
+  uint8_t  ie = ET0;                        // the tick may be masked on purpose
+  ET0 = 0;
+  ms  = TICK_ms;
+  ET0 = ie;
+  return ms;
+}
+
+uint32_t micros(void) {
+  uint32_t ms;
+  uint16_t t;
+  uint8_t  h;
+  uint8_t  ie = ET0;
+  ET0 = 0;
+  do {                                      // read the running timer consistently
+    h = TH0;
+    t = TL0;
+  } while(h != TH0);
+  t |= h << 8;
+  ms = TICK_ms;
+  if(TF0) ms++;                             // overflow pending: counting from 0
+  else    t -= TICK_reload;
+  ET0 = ie;
+  if(!CLK_cp4) return ms * 1000 + (uint32_t)t * 1000 / TICK_counts;
+  return ms * 1000 + (t / CLK_cp4 << 2) + (t % CLK_cp4 << 2) / CLK_cp4;
+}
+
+// ===================================================================================
+// Follow a Clock Switch
+// ===================================================================================
+// Called by CLK_set() with the Timer0 interrupt disabled. t is the count at the
+// switch, cp4 the old Fsys cycles per 4us, Timer0 counts at the new Fsys since. The
+// point within the millisecond is carried over in 4us steps.
+void TICK_rescale(uint16_t t, uint8_t cp4) {
+  uint16_t phase, now;
+  uint8_t  pending = TF0;                   // a ms was due before the switch
+  uint16_t start = t;
+  if(!pending) t -= TICK_reload;            // old counts into the current ms
+  phase = t / cp4 * CLK_cp4;                // the same point in new counts
+  TICK_counts = 250 * CLK_cp4;
+  TICK_reload = 65536 - TICK_counts;
+  if(!TR0) return;                          // tick not started
+  TR0 = 0;
+  now = TL0 | (TH0 << 8);
+  phase += (uint16_t)(now - start) + TICK_SWITCH;  // new counts since the switch
+  if(pending || phase >= TICK_counts) {     // a ms is due: counting from 0
+    if(!pending) phase -= TICK_counts;
+    TF0 = 1;
+  }
+  else {
+    TF0 = 0;                                // drop an overflow of the old count
+    phase += TICK_reload;
+  }
+  TL0 = (uint8_t)phase;
+  TH0 = (uint8_t)(phase >> 8);
+  TR0 = 1;
+}
+
+// ===================================================================================
+// Low-Power Wait
+// ===================================================================================
+void TICK_sleep(uint16_t ms) {
+  uint8_t tl, th, ie;
+  if(!ms) return;
+  while(!(TKEY_CTRL & bTKC_IF));            // align with the 1ms touch-key timer,
+  while(TKEY_CTRL & bTKC_IF);               // so the slept time is exact
+  TR0 = 0;                                  // Timer0 would run at 187.5kHz
+  tl = TL0;                                 // sub-ms phase of the tick
+  th = TH0;
+  DLY_sleep_ms(ms);
+  ie  = ET0;
+  ET0 = 0;
+  TICK_ms += ms;
+  TL0 = tl;                                 // continue where the tick stopped
+  TH0 = th;
+  ET0 = ie;
+  TR0 = 1;
+}
+
+// ===================================================================================
+// Deadlines
+// ===================================================================================
+deadline_t deadline_set(uint16_t ms) {
+  return millis() + ms + 1;                 // +1: the current ms has partly elapsed
+}
+
+uint8_t deadline_expired(deadline_t deadline) {
+  return (int32_t)(millis() - deadline) >= 0;
+}
@@ -0,0 +1,35 @@
+// ===================================================================================
+// System Tick Functions for CH551, CH552 and CH554                           * v1.1 *
+// ===================================================================================
+//
+// Timer0 interrupts once per millisecond and counts the time since TICK_init().
+// millis() returns that count, micros() adds the fraction of the current millisecond
+// read from the timer. Deadlines turn blocking waits into checks, so the waiting
+// time can be spent on other work:
+//
+//   deadline_t d = deadline_set(5);  // at least 5ms from now
+//   ...                              // other work
+//   while(!deadline_expired(d));     // wait for the rest, if any
+//
+// A deadline_t is a point on the millisecond count, it may be checked up to 24 days
+// after it passed. Timer0 runs at Fsys (bTMR_CLK, bT0_CLK), TICK_init() enables
+// the global interrupts. TICK_sleep() waits at the lowest clock (see DLY_sleep_ms())
+// with the timer stopped and adds the time afterwards. The tick follows CLK_set()
+// (see clock.h). The interrupt prototype below must be visible in the file with
+// main(), include this header there (lcd1602.h does).
+
+#pragma once
+#include <stdint.h>
+#include "ch554.h"
+
+typedef uint32_t deadline_t;
+
+void TICK_init(void);                           // start the 1ms tick (Timer0)
+uint32_t millis(void);                          // ms since TICK_init()
+uint32_t micros(void);                          // us since TICK_init(), wraps after ~71min
+void TICK_sleep(uint16_t ms);                   // low-power wait of ms, the count advances
+deadline_t deadline_set(uint16_t ms);           // deadline at least ms from now
+uint8_t deadline_expired(deadline_t deadline);  // 1 if the deadline has passed
+void TICK_rescale(uint16_t t, uint8_t cp4);     // used by CLK_set()
+
+void TICK_interrupt(void) __interrupt(INT_NO_TMR0);
@@ -0,0 +1,65 @@
+// ===================================================================================
+// Bench Firmware of the TM1637 Driver (make bench)
+// ===================================================================================
+//
+// Runs headless in ucsim (s51 -t 8052), driven by tools/bench.py. Each bench stores
+// the cycles of its call in bench_cycles[], in the order of BENCH_NAMES in the
+// makefile, and bench_done() is where the simulator stops to dump them.
+//
+// ucsim counts the machine cycles of a classic 8051 and so does its Timer2, i.e.
+// the numbers are exact for the simulated core and comparable between builds, but
+// not the 1T cycles of a real CH55x. DLY_us() counts the same Timer2, so its bench
+// shows the call overhead on this core, not its accuracy on hardware.
+
+#include "../src/config.h"
+#include "../src/system.h"
+#include "../src/delay.h"
+#include "../src/tm1637plus.h"
+
+#define BENCH_MAX 16
+
+__xdata __at(0x0000) volatile uint32_t bench_cycles[BENCH_MAX]; // below XRAM_LOC
+static volatile uint16_t bench_hi;  // Timer2 overflows
+
+void BENCH_interrupt(void) __interrupt(INT_NO_TMR2) {
+  TF2 = 0;
+  bench_hi++;
+}
+
+// 32-bit Timer2 count, the overflow interrupt extends DLY_count()
+static uint32_t bench_now(void) {
+  uint16_t hi, lo;
+  do {
+    hi = bench_hi;
+    lo = DLY_count();
+  } while(hi != bench_hi);
+  return ((uint32_t)hi << 16) | lo;
+}
+
+#define BENCH(i, call) do {                         \
+  uint32_t _t = bench_now();                        \
+  call;                                             \
+  bench_cycles[i] = bench_now() - _t;               \
+} while(0)
+
+void bench_done(void) {             // breakpoint of tools/bench.py
+  while(1);
+}
+
+void main(void) {
+  CLK_config();
+  DLY_init();
+  ET2 = 1;
+  EA  = 1;
+  tm1637_init();
+
+  BENCH(0, );                       // cost of the measurement itself
+  BENCH(1, tm1637_show("12.34", 1));
+  BENCH(2, tm1637_number(-1234));   // formats into the framebuffer only
+  BENCH(3, tm1637_flush());
+  BENCH(4, DLY_us(1));
+  BENCH(5, DLY_us(10));
+  BENCH(6, DLY_us(100));
+  BENCH(7, DLY_us(1000));
+  bench_done();
+}
@@ -0,0 +1,103 @@
+// ===================================================================================
+// Host Mock of the CH551, CH552 and CH554 SFR Layer                          * v1.0 *
+// ===================================================================================
+//
+// Forced include (-include host/ch554_host.h) of the host build ("make host"). The
+// drivers compile unchanged with gcc/clang as C++: the SFRs and sbits declared by
+// ch554.h and gpio.h become objects whose reads and writes go to host.cpp, which
+// keeps the register file, records every port pin transition with a virtual
+// timestamp and lets Timer2 and the touch-key timer run on the virtual clock.
+//
+// The virtual clock advances by a rough cost model, not by the real instruction
+// timing (use "make bench" for exact cycle counts):
+// - every SFR access                     1 cycle
+// - inline assembly (nop, sjmp, orl)     1, 4, 3 cycles
+// - one pass of an inline delay loop     4 cycles (DLY_LOOP)
+// - host_spend(n)                        n cycles, used by the system tick stubs
+// The time of a cycle follows CLOCK_CFG, as on the chip.
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SDCC keywords
+#define __data
+#define __idata
+#define __pdata
+#define __xdata
+#define __code
+#define __bit           bool
+#define __at(x)
+#define __interrupt(x)
+#define __using(x)
+#define __critical
+#define __reentrant
+#define __naked
+#define __asm__(s)      host_asm(s)
+#define DLY_LOOP()      host_spend(4)
+
+// ===================================================================================
+// Host API
+// ===================================================================================
+typedef struct {
+  uint64_t ns;                      // virtual time of the transition
+  uint8_t  pin;                     // P10 .. P37 (gpio.h)
+  uint8_t  level;                   // new output latch level
+} HOST_EDGE;
+
+void     host_reset(void);                        // power-on state, time 0, empty log
+void     host_spend(uint16_t cycles);             // advance the virtual clock
+void     host_asm(const char *s);                 // charge an inline assembly line
+uint64_t host_ns(void);                           // virtual time in ns
+uint32_t host_cycles(void);                       // Fsys cycles since host_reset()
+uint32_t host_edges(void);                        // number of recorded transitions
+const HOST_EDGE *host_edge(uint32_t i);           // i-th transition
+void     host_pull_low(uint8_t port, uint8_t mask);  // pins held low by a device
+void     host_dump_vcd(FILE *f);                  // transitions as value change dump
+
+uint8_t  host_sfr_read(uint8_t addr);
+void     host_sfr_write(uint8_t addr, uint8_t val);
+
+// ===================================================================================
+// SFR Objects
+// ===================================================================================
+struct HostSfr {
+  uint8_t a;
+  operator uint8_t() const { return host_sfr_read(a); }
+  const HostSfr &operator=(unsigned v) const { host_sfr_write(a, (uint8_t)v); return *this; }
+  const HostSfr &operator|=(unsigned v) const { return *this = host_sfr_read(a) | v; }
+  const HostSfr &operator&=(unsigned v) const { return *this = host_sfr_read(a) & v; }
+  const HostSfr &operator^=(unsigned v) const { return *this = host_sfr_read(a) ^ v; }
+  const HostSfr &operator+=(unsigned v) const { return *this = host_sfr_read(a) + v; }
+  const HostSfr &operator-=(unsigned v) const { return *this = host_sfr_read(a) - v; }
+  const HostSfr &operator++() const { return *this += 1; }
+  const HostSfr &operator--() const { return *this -= 1; }
+  uint8_t operator++(int) const { uint8_t v = *this; *this = v + 1; return v; }
+  uint8_t operator--(int) const { uint8_t v = *this; *this = v - 1; return v; }
+};
+
+struct HostSfr16 {
+  uint8_t a;
+  operator uint16_t() const { return host_sfr_read(a) | (host_sfr_read(a + 1) << 8); }
+  const HostSfr16 &operator=(unsigned v) const {
+    host_sfr_write(a, (uint8_t)v);
+    host_sfr_write(a + 1, (uint8_t)(v >> 8));
+    return *this;
+  }
+};
+
+struct HostBit {
+  uint8_t a, b;
+  operator uint8_t() const { return (host_sfr_read(a) >> b) & 1; }
+  const HostBit &operator=(unsigned v) const {
+    uint8_t r = host_sfr_read(a);
+    host_sfr_write(a, v ? r | (1 << b) : r & ~(1 << b));
+    return *this;
+  }
+};
+
+#define SBIT(name, addr, bit)  constexpr HostBit   name = {addr, bit}
+#define SFR(name, addr)        constexpr HostSfr   name = {addr}
+#define SFR16(name, addr)      constexpr HostSfr16 name = {addr}
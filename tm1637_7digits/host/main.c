@@ -0,0 +1,46 @@
+// ===================================================================================
+// Host Run of the TM1637 Driver (make host)
+// ===================================================================================
+//
+// Runs the driver against the mock SFR layer and prints the bus activity. With a
+// file name as argument, the pin transitions are written there as a value change
+// dump (e.g. for GTKWave).
+
+#include "../src/config.h"
+#include "../src/tm1637plus.h"
+
+int main(int argc, char **argv)
+{
+  uint64_t t;
+  FILE *f;
+
+  host_reset();
+  tm1637_init();
+  printf("tm1637_init:        %8llu ns, %6u transitions\n",
+         (unsigned long long)host_ns(), host_edges());
+
+  t = host_ns();
+  tm1637_show("12.34", 0);
+  printf("tm1637_show:        %8llu ns\n", (unsigned long long)(host_ns() - t));
+
+  t = host_ns();
+  tm1637_decimal(-123, 0, TM1637_DIGITS, 0);
+  tm1637_flush();
+  printf("tm1637_decimal:     %8llu ns\n", (unsigned long long)(host_ns() - t));
+
+  printf("total:              %8llu ns, %6u transitions, %u cycles\n",
+         (unsigned long long)host_ns(), host_edges(), host_cycles());
+
+  if (argc > 1)
+  {
+    f = fopen(argv[1], "w");
+    if (!f)
+    {
+      perror(argv[1]);
+      return 1;
+    }
+    host_dump_vcd(f);
+    fclose(f);
+  }
+  return 0;
+}
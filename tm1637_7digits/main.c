@@ -46,11 +46,11 @@
 // ===================================================================================
 
 // Libraries
-#include <stdio.h>
 #include "src/config.h"     // user configurations
 #include "src/system.h"     // system functions
 #include "src/gpio.h"       // for GPIO
 #include "src/delay.h"      // for delays
+#include "src/sched.h"      // task scheduler
 #include "src/tm1637plus.h" // tm1637 7digit display driver
 
 // ===================================================================================
@@ -60,52 +60,52 @@
 #define true 1
 #define false 0
 
-void main(void)
+// keyframes: duration in 10ms ticks, segments of the 4 digits
+__code const uint8_t chase[] = {
+    10, 0x01, 0x01, 0x01, 0x01,
+    10, 0x02, 0x02, 0x02, 0x02,
+    10, 0x04, 0x04, 0x04, 0x04,
+    10, 0x08, 0x08, 0x08, 0x08,
+    10, 0x10, 0x10, 0x10, 0x10,
+    10, 0x20, 0x20, 0x20, 0x20,
+    0};
+
+// Demo sequence, a protothread polled every 10ms
+static void demo(void)
 {
-  // Setup
-  CLK_config();  // configure system clock
-  DLY_ms(5);     // wait for clock to stabilize
-  tm1637_init(); // initialize the display
+  static int16_t t;
+  static uint8_t x;
 
+  TASK_BEGIN();
   while (1)
   {
-    // Test brightness
-    for (int x = 0; x < 7; x++)
-    {
-      tm1637_set_brightness(x);
-      tm1637_show("8888", false);
-      DLY_ms(100);
-    }
+    // Test brightness: fade in
+    tm1637_set_brightness(0);
+    tm1637_show("8888", false);
+    tm1637_fade(7, 70);
+    TASK_WAIT_UNTIL(!tm1637_fading());
 
-    // Test segment control
-    uint8_t __code seg_data[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20};
-    for (uint8_t x = 0; x < 32; ++x)
-    {
-      uint8_t data = seg_data[x % 6];
-      tm1637_set_raw(0, data);
-      tm1637_set_raw(1, data);
-      tm1637_set_raw(2, data);
-      tm1637_set_raw(3, data);
-      DLY_ms(100);
-    }
+    // Test segment control: chase the outer segments on all digits
+    tm1637_anim_play(chase, 5);
+    TASK_WAIT_UNTIL(!tm1637_anim_playing());
+
+    // Display time with blinking colon
+    tm1637_clock(12, 25, TM1637_COLON);
+    tm1637_flush();
+    tm1637_blink(1, 0x80, 50);
+    TASK_SLEEP(7500);
+    tm1637_blink(1, 0, 0);
 
-    for (uint8_t x = 0; x < 3; ++x)
+    // Test temperature display
+    for (t = -125; t <= 250; t += 25)
     {
-      // Display time with blinking dots
-      for (int z = 0; z < 5; ++z)
-      {
-        char tmp[5];
-        sprintf(tmp, "%.4d", 1225);
-        tm1637_set_char(0, tmp[0], z % 2);
-        tm1637_set_char(1, tmp[1], z % 2);
-        tm1637_set_char(2, tmp[2], z % 2);
-        tm1637_set_char(3, tmp[3], z % 2);
-        DLY_ms(500);
-      }
+      tm1637_temperature(t);
+      tm1637_flush();
+      TASK_SLEEP(100);
     }
 
     // Test display numbers
-    for (int x = 0; x < 16; ++x)
+    for (x = 0; x < 16; ++x)
     {
       uint8_t show_dot = x % 2; // Show dot every 2nd cycle
       uint8_t v = x < 10 ? x + '0' : x - 10 + 'a';
@@ -113,7 +113,25 @@ void main(void)
       tm1637_set_char(1, v, show_dot); // On my display "dot" (clock symbol ":") connected only here
       tm1637_set_char(2, v, show_dot);
       tm1637_set_char(3, v, show_dot);
-      DLY_ms(100);
+      tm1637_flush();
+      TASK_SLEEP(100);
     }
   }
+  TASK_END();
+}
+
+__code const SCHED_TASK tasks[] = {
+    {tm1637_fx_tick, 10}, // display effects
+    {demo, 10},           // demo sequence
+};
+
+void main(void)
+{
+  // Setup
+  CLK_config();  // configure system clock
+  DLY_ms(5);     // wait for clock to stabilize
+  tm1637_init(); // initialize the display
+
+  SCHED_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+  SCHED_run();
 }
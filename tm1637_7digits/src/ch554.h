@@ -13,6 +13,7 @@
 typedef unsigned char volatile __xdata    UINT8XV;
 typedef unsigned char volatile __pdata    UINT8PV;
 
+#ifndef SBIT                    // the host build (host/ch554_host.h) brings its own
 #define SBIT(name, addr, bit)  __sbit  __at(addr+bit) name
 #define SFR(name, addr)        __sfr   __at(addr) name
 #define SFRX(name, addr)       __xdata volatile unsigned char __at(addr) name
@@ -20,6 +21,7 @@ typedef unsigned char volatile __pdata    UINT8PV;
 #define SFR16E(name, fulladdr) __sfr16 __at(fulladdr) name
 #define SFR32(name, addr)      __sfr32 __at(((addr+3UL)<<24) | ((addr+2UL)<<16) | ((addr+1UL)<<8) | addr) name
 #define SFR32E(name, fulladdr) __sfr32 __at(fulladdr) name
+#endif
 
 /*----- SFR --------------------------------------------------------------*/
 /*  sbit are bit addressable, others are byte addressable */
@@ -0,0 +1,35 @@
+// ===================================================================================
+// System Clock Scaling for CH551, CH552 and CH554                            * v1.0 *
+// ===================================================================================
+
+#include "clock.h"
+#include "systick.h"
+
+__data uint8_t CLK_sel = CLK_BOOT;
+__data uint8_t CLK_cp4 = CLK_BOOT_CP4;
+
+// Fsys cycles per 4us for each clock selection (187.5kHz: not selectable)
+static __code const uint8_t CLK_cp4_tab[8] = {0, 3, 12, 24, 48, 64, 96, 128};
+
+// ===================================================================================
+// Switch the System Clock
+// ===================================================================================
+void CLK_set(uint8_t sel) {
+  uint16_t t;
+  uint8_t  cp4 = CLK_cp4;
+  uint8_t  ie  = ET0;
+  uint8_t  run = TR0;
+  if(sel == CLK_sel || sel < CLK_750KHZ || sel > CLK_MAX || !cp4) return;
+  ET0 = 0;                          // the tick is moved to the new clock below
+  TR0 = 0;
+  t = TL0 | (TH0 << 8);             // Timer0 count at the switch
+  SAFE_MOD  = 0x55;
+  SAFE_MOD  = 0xAA;                 // enter safe mode
+  CLOCK_CFG = (CLOCK_CFG & ~MASK_SYS_CK_SEL) | sel;
+  SAFE_MOD  = 0x00;                 // terminate safe mode
+  TR0 = run;
+  CLK_sel = sel;
+  CLK_cp4 = CLK_cp4_tab[sel];
+  TICK_rescale(t, cp4);
+  ET0 = ie;
+}
@@ -8,6 +8,29 @@
 #define PIN_BUZZER          P15       // buzzer pin
 #define PIN_SDA             P16       // I2C SDA
 #define PIN_SCL             P17       // I2C SCL
+#define PIN_TM1637_CLK      P33       // TM1637 CLK
+#define PIN_TM1637_DIO      P34       // TM1637 DIO (module 0)
+//#define PIN_TM1637_DIO1   P35       // DIO of module 1, same port as PIN_TM1637_DIO
+//#define PIN_TM1637_DIO2   P36       // ... up to PIN_TM1637_DIO7
+
+// TM1637 display
+#define TM1637_DIGITS       4         // number of digits of the module (up to 6)
+//#define TM1637_GRID_MAP   2, 1, 0, 5, 4, 3 // digit shown on each grid (6-digit boards)
+#define TM1637_MODULES      1         // number of modules sharing PIN_TM1637_CLK
+#define TM1637_BIT_US       2         // half clock period in us (2 -> ~250kHz)
+//#define TM1637_ASYNC_US   10        // half clock period of tm1637_flush_async() (Timer1)
+//#define TM1637_DIM_HZ     800       // per-digit dimming frame rate (Timer1)
+//#define TM1637_DIM_LEVELS 4         // frames per dimming cycle
+// TM1637_ASYNC_US and TM1637_DIM_HZ take Timer1 from UART0, Timer2 is the delay
+// counter: no UART_BAUD then, use UART0 mode 2 or UART1 (see tm1637plus.h)
+
+// Scheduler
+//#define SCHED_SLEEP                   // idle at 187.5kHz between the tasks
+//#define SCHED_CLK_IDLE    CLK_750KHZ  // clock while waiting for a task
+//#define SCHED_CLK_BURST   CLK_24MHZ   // clock of the tasks (FREQ_MAX = 24000000)
+
+// Profiler
+//#define PROF_ENABLE                   // cycle counts of the library functions (prof.h)
 
 // USB device descriptor
 #define USB_VENDOR_ID       0x16C0    // VID (shared www.voti.nl)
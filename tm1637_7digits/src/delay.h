@@ -1,10 +1,65 @@
 // ===================================================================================
-// Delay Functions for CH551, CH552 and CH554                                 * v1.1 *
+// Delay Functions for CH551, CH552 and CH554                                 * v1.3 *
 // ===================================================================================
 
 #pragma once
 #include <stdint.h>
 #include "ch554.h"
+#include "clock.h"
 
 void DLY_us(uint16_t n);   // delay in units of us
 void DLY_ms(uint16_t n);   // delay in units of ms
+void DLY_init(void);       // start Timer2 as Fsys cycle counter (done by DLY_us)
+uint16_t DLY_count(void);  // Fsys cycles counted by Timer2
+
+// DLY_us() counts Fsys cycles on Timer2, which runs free at Fsys (bTMR_CLK, bT2_CLK,
+// started on the first call, shared with the I2C trace). Interrupts during the wait
+// do not lengthen it unless they still run at its end. DLY_US_OVERHEAD is the cost
+// of the call and the timer reads, it is subtracted from the wait. The cycles per
+// us follow CLK_set() (see clock.h).
+//
+// DLY_us_const(n) is for constant n: waits up to DLY_INLINE_MAX cycles are inlined
+// as NOPs (1 cycle each) after a DJNZ loop (~4 cycles per pass) for the bulk, longer
+// ones call DLY_us(). DLY_cycles(c) inlines c < 1024 cycles the same way and never
+// calls DLY_us(), so it is safe in interrupts. Waits below 8 cycles are NOPs only and
+// exact to the cycle. Above, the loop counter load and the passes depend on the code
+// SDCC generates for the loop, the wait is c cycles within about +-3. Inlined waits
+// are sized for F_MAX, at lower clocks they take longer.
+#ifndef DLY_US_OVERHEAD
+#define DLY_US_OVERHEAD   48        // Fsys cycles, estimated from the generated code
+#endif
+#define DLY_INLINE_MAX    64        // longest inlined wait in Fsys cycles
+#define DLY_CPU_MHZ       (F_MAX / 1000000)
+
+#ifndef DLY_LOOP
+#define DLY_LOOP()                  // body of the delay loops (host build: charges it)
+#endif
+
+#define DLY_nop(c, k)     if((c) > (k)) __asm__("nop")
+#define DLY_cycles(c) do {                                    \
+  if((c) >= 8) { uint8_t _d = (uint8_t)((c) / 4); while(--_d) DLY_LOOP(); } \
+  DLY_nop((c) < 8 ? (c) : (c) % 4, 0);                        \
+  DLY_nop((c) < 8 ? (c) : (c) % 4, 1);                        \
+  DLY_nop((c) < 8 ? (c) : (c) % 4, 2);                        \
+  DLY_nop((c) < 8 ? (c) : (c) % 4, 3);                        \
+  DLY_nop((c) < 8 ? (c) : (c) % 4, 4);                        \
+  DLY_nop((c) < 8 ? (c) : (c) % 4, 5);                        \
+  DLY_nop((c) < 8 ? (c) : (c) % 4, 6);                        \
+} while(0)
+
+#define DLY_us_const(n) do {                                  \
+  if((uint32_t)(n) * DLY_CPU_MHZ <= DLY_INLINE_MAX)           \
+    DLY_cycles((n) * DLY_CPU_MHZ);                            \
+  else DLY_us(n);                                             \
+} while(0)
+
+// Low-power waits. The CH55x has no idle mode and power-down stops every timer, so
+// a timed wait runs the core at the lowest clock (187.5kHz) and counts the 1ms
+// touch-key timer ticks. Interrupts are served slowly meanwhile and USB does not
+// work. CLK_sel/CLK_cp4 describe 187.5kHz meanwhile, so DLY_us() in interrupts
+// keeps its length, but inlined DLY_cycles() waits are F_MAX / 187.5kHz times
+// longer and Timer0 is not rescaled (TICK_sleep() stops the tick around it). Event
+// waits power down until a WAKE_* source (system.h) fires, the sources already
+// enabled stay on.
+void DLY_sleep_ms(uint16_t n);           // wait n ticks of the 1ms timer at 187.5kHz
+void DLY_sleep_until(uint8_t source);    // power down until a WAKE_* source
@@ -0,0 +1,122 @@
+// ===================================================================================
+// Cycle Profiler for CH551, CH552 and CH554                                  * v1.0 *
+// ===================================================================================
+
+#include "prof.h"
+#include "delay.h"
+
+#ifdef PROF_ENABLE
+
+typedef struct {
+  uint16_t start;                   // Timer2 count at PROF_begin()
+  uint16_t count;                   // sections recorded (saturates)
+  uint16_t min;
+  uint16_t max;
+  uint32_t total;
+} PROF_PROBE;
+
+static __xdata PROF_PROBE PROF_probe[PROF_PROBES];
+static __xdata uint16_t   PROF_cost;  // cycles of an empty section
+
+// PROF_begin() and PROF_end() are also called from interrupts, they run with the
+// interrupts disabled and their locals must not be overlayed.
+#pragma save
+#pragma nooverlay
+
+// ===================================================================================
+// Probes
+// ===================================================================================
+void PROF_begin(uint8_t id) __critical {
+  PROF_probe[id].start = DLY_count();
+}
+
+void PROF_end(uint8_t id) __critical {
+  uint16_t t = DLY_count();
+  __xdata PROF_PROBE *p = &PROF_probe[id];
+  t -= p->start;
+  t  = t > PROF_cost ? t - PROF_cost : 0;
+  if(!p->count || t < p->min) p->min = t;
+  if(t > p->max) p->max = t;
+  p->total += t;
+  if(p->count != 0xffff) p->count++;
+}
+
+#pragma restore
+
+// ===================================================================================
+// Setup
+// ===================================================================================
+void PROF_reset(void) {
+  uint8_t i;
+  for(i = 0; i < PROF_PROBES; i++) {
+    PROF_probe[i].count = 0;
+    PROF_probe[i].max   = 0;
+    PROF_probe[i].total = 0;
+  }
+}
+
+void PROF_init(void) {
+  DLY_init();                       // Timer2 counts Fsys cycles
+  PROF_cost = 0;
+  PROF_reset();
+  PROF_begin(0);                    // an empty section is the cost of a probe
+  PROF_end(0);
+  PROF_cost = PROF_probe[0].min;
+  PROF_reset();
+}
+
+uint16_t PROF_count(uint8_t id) {
+  return PROF_probe[id].count;
+}
+
+// ===================================================================================
+// Report
+// ===================================================================================
+static uint16_t PROF_avg(uint8_t id) {
+  __xdata PROF_PROBE *p = &PROF_probe[id];
+  return p->count ? p->total / p->count : 0;
+}
+
+// writes the decimal digits of val to buf, returns the end
+static char *PROF_num(char *buf, uint32_t val) {
+  char tmp[10];
+  uint8_t n = 0;
+  do {
+    tmp[n++] = '0' + val % 10;
+    val /= 10;
+  } while(val);
+  while(n) *buf++ = tmp[--n];
+  return buf;
+}
+
+void PROF_report(void (*out)(char)) {
+  uint8_t i;
+  char line[32], *s, *e;
+  for(i = 0; i < PROF_PROBES; i++) {
+    if(!PROF_probe[i].count) continue;
+    e = PROF_num(line, i);
+    *e++ = ' ';
+    e = PROF_num(e, PROF_probe[i].count);
+    *e++ = ' ';
+    e = PROF_num(e, PROF_probe[i].min);
+    *e++ = ' ';
+    e = PROF_num(e, PROF_avg(i));
+    *e++ = ' ';
+    e = PROF_num(e, PROF_probe[i].max);
+    *e++ = '\r';
+    *e++ = '\n';
+    for(s = line; s < e; s++) out(*s);
+  }
+}
+
+void PROF_line(uint8_t id, char *buf) {
+  char *e = PROF_num(buf, id);
+  *e++ = ':';
+  e = PROF_num(e, PROF_avg(id));
+  *e++ = '/';
+  e = PROF_num(e, PROF_probe[id].max);
+  while(e < buf + 16) *e++ = ' ';   // clear the rest of the LCD line
+  *e = 0;
+}
+
+#endif // PROF_ENABLE
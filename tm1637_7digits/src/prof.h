@@ -0,0 +1,62 @@
+// ===================================================================================
+// Cycle Profiler for CH551, CH552 and CH554                                  * v1.0 *
+// ===================================================================================
+//
+// PROF_BEGIN(id) and PROF_END(id) around a piece of code count its Fsys cycles on
+// Timer2 (see DLY_us()) and keep count, min, max and total per probe in XRAM. The
+// library functions carry the probes listed below, own ones start at PROF_USER:
+//
+//   PROF_init();                     // once, starts Timer2, measures the probe cost
+//   ...
+//   PROF_BEGIN(PROF_USER);
+//   render();
+//   PROF_END(PROF_USER);
+//   ...
+//   PROF_report(UART_write);         // "id count min avg max" per probe hit
+//   PROF_line(PROF_I2C_WRITE, buf);  // "id:avg/max" in 16 characters for the LCD
+//
+// The probes compile to nothing unless PROF_ENABLE is defined in config.h. The cost
+// of a probe is subtracted, but not that of probes nested inside it: an outer count
+// includes one probe cost per inner hit (PROF_LCD_DATA: four PROF_I2C_WRITE hits).
+// A section longer than 65535 cycles or spanning a CLK_set() is counted wrong.
+// Probes may be hit from interrupts, the same id must not nest.
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+#define PROF_LCD_DATA   0           // _hal_write_data() of lcd1602.c, without busy wait,
+                                    // with the cost of its four PROF_I2C_WRITE probes
+#define PROF_I2C_WRITE  1           // I2C_write() of every bus
+#define PROF_TM_WRITE   2           // tm1637_write()
+#define PROF_TM_BYTE    3           // _write_byte() of tm1637plus.c
+#define PROF_USER       4           // first application probe
+
+#ifndef PROF_PROBES
+#define PROF_PROBES     8           // number of probes
+#endif
+
+#ifdef PROF_ENABLE
+
+#define PROF_BEGIN(id)  PROF_begin(id)
+#define PROF_END(id)    PROF_end(id)
+
+void PROF_init(void);                         // start Timer2, measure the probe cost
+void PROF_reset(void);                        // clear all probes
+void PROF_begin(uint8_t id);                  // start a section
+void PROF_end(uint8_t id);                    // end a section and record its cycles
+uint16_t PROF_count(uint8_t id);              // number of sections recorded
+void PROF_report(void (*out)(char));          // all probes hit, one line each
+void PROF_line(uint8_t id, char *buf);        // one probe in 16 characters + '\0'
+
+#else
+
+#define PROF_BEGIN(id)
+#define PROF_END(id)
+#define PROF_init()
+#define PROF_reset()
+#define PROF_count(id)        0
+#define PROF_report(out)
+#define PROF_line(id, buf)    (buf)[0] = 0
+
+#endif
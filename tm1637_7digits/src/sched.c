@@ -0,0 +1,104 @@
+// ===================================================================================
+// Cooperative Task Scheduler for CH551, CH552 and CH554                      * v1.1 *
+// ===================================================================================
+
+#include "sched.h"
+#include "config.h"
+#include "clock.h"
+
+#if defined(SCHED_CLK_IDLE) && !defined(SCHED_CLK_BURST)
+#define SCHED_CLK_BURST CLK_BOOT           // clock while the tasks run
+#endif
+#if defined(SCHED_CLK_BURST) && SCHED_CLK_BURST > CLK_MAX
+#error SCHED_CLK_BURST is above CLK_MAX, raise FREQ_MAX in the makefile
+#endif
+
+static const SCHED_TASK __code *SCHED_tasks;
+static __xdata uint8_t    SCHED_count;
+static __xdata deadline_t SCHED_next[SCHED_MAX_TASKS];    // next release
+static __xdata uint8_t    SCHED_late[SCHED_MAX_TASKS];    // skipped releases
+
+// ===================================================================================
+// Start the Scheduler
+// ===================================================================================
+void SCHED_init(const SCHED_TASK __code *tasks, uint8_t count) {
+  uint8_t i;
+  uint32_t now;
+  TICK_init();
+  if(count > SCHED_MAX_TASKS) count = SCHED_MAX_TASKS;
+  SCHED_tasks = tasks;
+  SCHED_count = count;
+  now = millis();
+  for(i = 0; i < count; i++) {
+    SCHED_next[i] = now;                    // all tasks run on the first pass
+    SCHED_late[i] = 0;
+  }
+}
+
+// ===================================================================================
+// Call the Due Tasks
+// ===================================================================================
+void SCHED_poll(void) {
+  uint8_t i;
+  uint32_t now;
+  const SCHED_TASK __code *task = SCHED_tasks;
+  for(i = 0; i < SCHED_count; i++, task++) {
+    if(task->period) {
+      now = millis();
+      if((int32_t)(now - SCHED_next[i]) < 0) continue;   // not yet due
+      SCHED_next[i] += task->period;                      // periodic without drift
+      if((int32_t)(now - SCHED_next[i]) >= 0) {          // more than a period late
+        SCHED_next[i] = now + task->period;
+        if(SCHED_late[i] < 255) SCHED_late[i]++;
+      }
+    }
+    task->run();
+  }
+}
+
+// ===================================================================================
+// Run the Tasks
+// ===================================================================================
+#if defined(SCHED_SLEEP) || defined(SCHED_CLK_IDLE)
+static uint16_t SCHED_idle(void) {          // ms until the next release
+  uint8_t i;
+  int32_t gap, min = 0x7fff;
+  uint32_t now = millis();
+  for(i = 0; i < SCHED_count; i++) {
+    if(!SCHED_tasks[i].period) return 0;    // polled task, never idle
+    gap = (int32_t)(SCHED_next[i] - now);
+    if(gap < min) min = gap;
+  }
+  return min > 0 ? min : 0;
+}
+#endif
+
+void SCHED_run(void) {
+  #ifdef SCHED_SLEEP
+    uint16_t idle;
+  #endif
+  #ifdef SCHED_CLK_IDLE
+    CLK_set(SCHED_CLK_BURST);
+  #endif
+  while(1) {
+    SCHED_poll();
+    #ifdef SCHED_SLEEP
+      idle = SCHED_idle();
+      if(idle > 1) TICK_sleep(idle - 1);    // the alignment takes up to 1ms
+    #endif
+    #ifdef SCHED_CLK_IDLE
+      if(SCHED_idle()) {                    // wait for the next release slowly
+        CLK_set(SCHED_CLK_IDLE);
+        while(SCHED_idle());
+        CLK_set(SCHED_CLK_BURST);
+      }
+    #endif
+  }
+}
+
+// ===================================================================================
+// Statistics
+// ===================================================================================
+uint8_t SCHED_missed(uint8_t task) {
+  return task < SCHED_count ? SCHED_late[task] : 0;
+}
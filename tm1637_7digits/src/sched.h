@@ -0,0 +1,60 @@
+// ===================================================================================
+// Cooperative Task Scheduler for CH551, CH552 and CH554                      * v1.1 *
+// ===================================================================================
+//
+// The tasks are listed in a table in code memory. SCHED_run() calls every task when
+// its period has elapsed (period 0: on every pass). Tasks run to completion and must
+// not block. A task that falls more than a period behind skips the missed releases,
+// SCHED_missed() counts them. Sequences are written as protothreads, which return
+// at a TASK_ macro and resume there on the next call:
+//
+//   void blink(void) {
+//     TASK_BEGIN();
+//     while(1) {
+//       PIN_toggle(PIN_LED);
+//       TASK_SLEEP(500);
+//     }
+//     TASK_END();
+//   }
+//
+//   __code const SCHED_TASK tasks[] = {
+//     {blink,   10},                     // protothread, polled every 10ms
+//     {refresh, 20},                     // every 20ms
+//   };
+//
+//   SCHED_init(tasks, 2);
+//   SCHED_run();
+//
+// Locals of a protothread are lost at a TASK_ macro, make them static. Only one
+// TASK_ macro per line, no switch statement around one. Built on the system tick.
+//
+// With SCHED_SLEEP defined in config.h, SCHED_run() spends the time until the next
+// release in TICK_sleep() when every task has a period. Not for USB firmware.
+// With SCHED_CLK_IDLE (e.g. CLK_3MHZ) it waits for the next release at that clock
+// and runs the tasks at SCHED_CLK_BURST (default: F_CPU), see clock.h.
+
+#pragma once
+#include <stdint.h>
+#include "systick.h"
+
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 8                   // size of the task state table
+#endif
+
+typedef struct {
+  void (*run)(void);                        // task function
+  uint16_t period;                          // ms between calls, 0: every pass
+} SCHED_TASK;
+
+void SCHED_init(const SCHED_TASK __code *tasks, uint8_t count); // start the tick, release all tasks
+void SCHED_poll(void);                      // one pass over the task table
+void SCHED_run(void);                       // run the tasks forever
+uint8_t SCHED_missed(uint8_t task);         // releases skipped by a late task
+
+// Protothreads
+#define TASK_BEGIN()        static __xdata uint16_t _pt; static __xdata deadline_t _dl; \
+                            switch(_pt) { case 0:
+#define TASK_YIELD()        do { _pt = __LINE__; return; case __LINE__:; } while(0)
+#define TASK_WAIT_UNTIL(c)  do { _pt = __LINE__; case __LINE__: if(!(c)) return; } while(0)
+#define TASK_SLEEP(ms)      do { _dl = deadline_set(ms); TASK_WAIT_UNTIL(deadline_expired(_dl)); } while(0)
+#define TASK_END()          } _pt = 0
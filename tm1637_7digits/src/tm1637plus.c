@@ -29,149 +29,559 @@ SOFTWARE.
 */
 
 #include <string.h>
-#include <stdlib.h>
-#include <stdio.h>
 #include "tm1637plus.h"
 #include "delay.h"
 #include "gpio.h"
+#include "config.h"
+#include "prof.h"
+#include "font7seg.h"
 
 #define CONFIG_TM1637_BRIGHTNESS 7
 #define TM1637_ADDR_AUTO 0x40
 #define TM1637_ADDR_FIXED 0x44
+#define TM1637_READ_KEYS 0x42 // # 0x42 data command: read key scan data
 #define TM1637_CMD1 64  //  # 0x40 data command
 #define TM1637_CMD2 192 // # 0xC0 address command
 #define TM1637_CMD3 128 // # 0x80 display control command
 #define TM1637_DSP_ON 8 // # 0x08 display on
-#define TM1637_DELAY 50 // # 50us delay between clk/dio pulses
 #define TM1637_MSB 128  // # msb is the decimal point or the colon depending on your display
+#define TM1637_MINUS 0x40 // # segment g
+#define TM1637_DEGREE 0x63 // # segments a, b, f, g
 
-// 0-9, a-z, blank, dash, star
-__code char _SEGMENTS[] = "\x3F\x06\x5B\x4F\x66\x6D\x7D\x07\x7F\x6F\x77\x7C\x39\x5E\x79\x71\x3D\x76\x06\x1E\x76\x38\x55\x54\x3F\x73\x67\x50\x6D\x78\x3E\x1C\x2A\x76\x6E\x5B\x00\x40\x63";
-uint8_t __xdata m_brightness;
-uint8_t __xdata m_segments[5];
+// 0-9, a-f (all other characters are encoded through FONT7SEG)
+__code char _SEGMENTS[] = "\x3F\x06\x5B\x4F\x66\x6D\x7D\x07\x7F\x6F\x77\x7C\x39\x5E\x79\x71";
+#ifndef TM1637_DIGITS
+#define TM1637_DIGITS 4
+#endif
+#if TM1637_DIGITS > 6
+#error TM1637_DIGITS: the TM1637 has 6 grids
+#endif
 
-#define pin_clk PP33
-#define pin_dta PP34
+// Boards that wire the grids out of order (e.g. 6-digit modules wired 3-2-1-6-5-4)
+// define TM1637_GRID_MAP as the digit shown on each grid. The framebuffer stays in
+// logical order, the map is applied when it is sent.
+#ifdef TM1637_GRID_MAP
+static __code const uint8_t m_grid[TM1637_DIGITS] = {TM1637_GRID_MAP};
+#define TM1637_GRID(g) m_grid[g]
+#else
+#define TM1637_GRID(g) (g)
+#endif
 
-static void _delay(void);
-static void _write_data_cmd(void);
-static void _write_dsp_ctrl(void);
+// ===================================================================================
+// Modules
+// ===================================================================================
+// Up to 8 modules share the CLK line, every module has its own DIO pin on the port of
+// PIN_TM1637_DIO (PIN_TM1637_DIO1..PIN_TM1637_DIO7 for the others). A transaction
+// drives a set of DIO lanes at once: commands are broadcast, segment data is
+// transposed into bit planes, so one port write per bit clocks a different byte into
+// every module. DIO of the modules outside the transaction stays high, they never see
+// a START condition and ignore the clock. tm1637_select() picks the module the rest
+// of the API works on, tm1637_flush_all() updates all modules in one burst.
+#ifndef TM1637_MODULES
+#define TM1637_MODULES 1
+#endif
+#if TM1637_MODULES > 8
+#error TM1637_MODULES: at most 8 modules are supported
+#endif
+
+#ifndef PIN_TM1637_CLK
+#define PIN_TM1637_CLK P33
+#endif
+#ifndef PIN_TM1637_DIO
+#define PIN_TM1637_DIO P34
+#endif
+#define pin_clk PIN_set(PIN_TM1637_CLK)
+
+// DIO port access by lane mask, the port is selected at compile time
+#define TM1637_LANE(pin) (1 << ((pin) & 7))
+#define TM1637_DIO_P1 ((PIN_TM1637_DIO >= P10) && (PIN_TM1637_DIO <= P17))
+#define DIO_set(m) (TM1637_DIO_P1 ? (P1 |= (m)) : (P3 |= (m)))
+#define DIO_clr(m) (TM1637_DIO_P1 ? (P1 &= ~(m)) : (P3 &= ~(m)))
+#define DIO_xor(m) (TM1637_DIO_P1 ? (P1 ^= (m)) : (P3 ^= (m)))
+#define DIO_read() (TM1637_DIO_P1 ? P1 : P3)
+#define DIO_output(m) (TM1637_DIO_P1 ? (P1_MOD_OC &= ~(m), P1_DIR_PU |= (m)) \
+                                     : (P3_MOD_OC &= ~(m), P3_DIR_PU |= (m)))
+#define DIO_input_PU(m) (TM1637_DIO_P1 ? (P1_MOD_OC |= (m), P1_DIR_PU |= (m)) \
+                                       : (P3_MOD_OC |= (m), P3_DIR_PU |= (m)))
+
+// DIO lane of each module
+static __code const uint8_t m_lane[TM1637_MODULES] = {
+    TM1637_LANE(PIN_TM1637_DIO),
+#if TM1637_MODULES > 1
+    TM1637_LANE(PIN_TM1637_DIO1),
+#endif
+#if TM1637_MODULES > 2
+    TM1637_LANE(PIN_TM1637_DIO2),
+#endif
+#if TM1637_MODULES > 3
+    TM1637_LANE(PIN_TM1637_DIO3),
+#endif
+#if TM1637_MODULES > 4
+    TM1637_LANE(PIN_TM1637_DIO4),
+#endif
+#if TM1637_MODULES > 5
+    TM1637_LANE(PIN_TM1637_DIO5),
+#endif
+#if TM1637_MODULES > 6
+    TM1637_LANE(PIN_TM1637_DIO6),
+#endif
+#if TM1637_MODULES > 7
+    TM1637_LANE(PIN_TM1637_DIO7),
+#endif
+};
+
+// The lane masks address the port of PIN_TM1637_DIO only, all DIO pins must be on
+// it (P10-P17 or P30-P37). The pins are enum values, so this is checked by the
+// compiler instead of the preprocessor: a negative array size stops the build.
+#define TM1637_SAME_PORT(pin) (((pin) >> 3) == (PIN_TM1637_DIO >> 3))
+typedef char tm1637_dio_same_port[(1
+#if TM1637_MODULES > 1
+    && TM1637_SAME_PORT(PIN_TM1637_DIO1)
+#endif
+#if TM1637_MODULES > 2
+    && TM1637_SAME_PORT(PIN_TM1637_DIO2)
+#endif
+#if TM1637_MODULES > 3
+    && TM1637_SAME_PORT(PIN_TM1637_DIO3)
+#endif
+#if TM1637_MODULES > 4
+    && TM1637_SAME_PORT(PIN_TM1637_DIO4)
+#endif
+#if TM1637_MODULES > 5
+    && TM1637_SAME_PORT(PIN_TM1637_DIO5)
+#endif
+#if TM1637_MODULES > 6
+    && TM1637_SAME_PORT(PIN_TM1637_DIO6)
+#endif
+#if TM1637_MODULES > 7
+    && TM1637_SAME_PORT(PIN_TM1637_DIO7)
+#endif
+) ? 1 : -1];
+
+uint8_t __xdata m_brightness[TM1637_MODULES];
+uint8_t __xdata m_fb[TM1637_MODULES][TM1637_DIGITS]; // framebuffers, sent by tm1637_flush()
+uint8_t __xdata m_dirty;                             // modules whose framebuffer differs from the display
+static uint8_t __data m_lanes;                       // DIO lanes of the current transaction
+static uint8_t __xdata m_planes[8];                  // lane pattern of each bit, LSB first
+static __bit m_busy;                                 // transaction in progress
+#ifdef TM1637_ASYNC_US
+static volatile __bit m_async;                       // interrupt driven transmission in progress
+#endif
+
+#if TM1637_MODULES > 1
+static uint8_t __xdata m_module; // module selected by tm1637_select()
+#else
+#define m_module 0
+#endif
+#define m_segments m_fb[m_module]
+
+// segments hidden by the blink engine and digits blanked by the dimming, applied to
+// the framebuffer of m_fx_module
+static uint8_t __xdata m_hide[TM1637_DIGITS];
+static uint8_t __data m_dark;
+#define TM1637_VISIBLE(module, seg, d) \
+    ((module) == m_fx_module ? (m_dark & (1 << (d)) ? 0 : (seg)[d] & ~m_hide[d]) : (seg)[d])
+#if TM1637_MODULES > 1
+static uint8_t __xdata m_fx_module; // module driven by the fade/blink engine
+#else
+#define m_fx_module 0
+#endif
+
+// Half clock period in us. The TM1637 accepts clock rates up to about 250kHz,
+// i.e. 2us per half period. The period is always inlined by DLY_cycles() (DJNZ and
+// NOPs sized for F_MAX): the bit functions run in the Timer1 and tick interrupts,
+// where the non-reentrant DLY_us() must not be called.
+#ifndef TM1637_BIT_US
+#define TM1637_BIT_US 2
+#endif
+#if TM1637_BIT_US * DLY_CPU_MHZ >= 1024
+#error TM1637_BIT_US is too long for an inlined delay at this F_MAX
+#endif
+#define TM1637_DELAY() DLY_cycles(TM1637_BIT_US * DLY_CPU_MHZ)
+
+// Half clock period of tm1637_flush_async(), counted by Timer1 at Fsys/12
+#if defined(TM1637_ASYNC_US) && defined(TM1637_DIM_HZ)
+#error TM1637_ASYNC_US and TM1637_DIM_HZ both need Timer1
+#endif
+#if (defined(TM1637_ASYNC_US) || defined(TM1637_DIM_HZ)) && defined(UART_BAUD)
+#if defined(UART_TIMER) && UART_TIMER == 2
+#error UART_TIMER 2: Timer2 is the Fsys counter of DLY_us(), use UART0 mode 2 or UART1
+#else
+#error TM1637_ASYNC_US and TM1637_DIM_HZ use Timer1, the baud rate generator of UART0 (UART_BAUD)
+#endif
+#endif
+// Per-digit dimming: frame rate of the Timer1 interrupt and number of frames per
+// refresh cycle (TM1637_DIM_LEVELS + 1 brightness steps per digit)
+#ifdef TM1637_DIM_HZ
+#ifndef TM1637_DIM_LEVELS
+#define TM1637_DIM_LEVELS 4
+#endif
+#define TM1637_DIM_RELOAD (F_CPU / 12 / TM1637_DIM_HZ)
+#if TM1637_DIM_RELOAD > 65535
+#error TM1637_DIM_HZ is too low for Timer1 at this F_CPU
+#endif
+// worst case frame: address + all digits, START/STOP
+#define TM1637_DIM_BURST_US ((TM1637_DIGITS + 1) * 18 * TM1637_BIT_US + 4 * TM1637_BIT_US)
+#if TM1637_DIM_BURST_US * TM1637_DIM_HZ > 500000
+#warning TM1637_DIM_HZ: the dimming frames take more than half of the CPU time
+#endif
+static uint8_t __xdata m_dim[TM1637_DIGITS]; // brightness per digit, 0-TM1637_DIM_LEVELS
+#endif
+
+#ifdef TM1637_ASYNC_US
+#define TM1637_ASYNC_RELOAD (F_CPU / 1000000 * TM1637_ASYNC_US / 12)
+#if TM1637_ASYNC_RELOAD > 255 || TM1637_ASYNC_RELOAD < 1
+#error TM1637_ASYNC_US is out of range for Timer1 at this F_CPU
+#endif
+#endif
+
+static void _write_data_cmd(uint8_t lanes) __reentrant;
+static void _write_dsp_ctrl(uint8_t lanes) __reentrant;
+static void _set_segment(const uint8_t pos, const uint8_t data);
 
 void tm1637_init(void)
 {
-    m_brightness = CONFIG_TM1637_BRIGHTNESS & 7;
+    uint8_t i, lanes = 0;
+    for (i = 0; i < TM1637_MODULES; ++i)
+    {
+        m_brightness[i] = CONFIG_TM1637_BRIGHTNESS & 7;
+        lanes |= m_lane[i];
+    }
 
-    // Set CLK to low during DIO initialization to avoid sending a start signal by mistake
-    P3_MOD_OC &= ~(1 << pin_clk);
-    P3_DIR_PU |= (1 << pin_clk);
-    P3_MOD_OC &= ~(1 << pin_dta);
-    P3_DIR_PU |= (1 << pin_dta);
-    pin_clk = 0;
-    pin_dta = 0;
+    // All lines idle HIGH, so that the first START is a HIGH to LOW transition of DIO
+    PIN_output(PIN_TM1637_CLK);
+    DIO_output(lanes);
+    pin_clk = 1;
+    DIO_set(lanes);
 
-    _delay();
+    TM1637_DELAY();
 
-    _write_data_cmd();
-    _write_dsp_ctrl();
-}
+    _write_data_cmd(lanes);
+    _write_dsp_ctrl(lanes);
 
-static void _delay(void)
-{
-    DLY_us(TM1637_DELAY);
+    // The display RAM keeps its content over a reset, blank it to match the framebuffers
+    m_dirty = (uint8_t)((1 << TM1637_MODULES) - 1);
+    tm1637_flush_all();
+
+#ifdef TM1637_ASYNC_US
+    // Timer1 mode 2 (8-bit auto reload) at Fsys/12, started by tm1637_flush_async()
+    TMOD = (TMOD & 0x0f) | bT1_M1;
+    T2MOD &= ~bT1_CLK;
+    TH1 = (uint8_t)(256 - TM1637_ASYNC_RELOAD);
+    ET1 = 1;
+#endif
+#ifdef TM1637_DIM_HZ
+    for (i = 0; i < TM1637_DIGITS; ++i)
+    {
+        m_dim[i] = TM1637_DIM_LEVELS;
+    }
+    // Timer1 mode 1 (16-bit) at Fsys/12, reloaded by the interrupt
+    TMOD = (TMOD & 0x0f) | bT1_M0;
+    T2MOD &= ~bT1_CLK;
+    TH1 = (uint8_t)((65536 - TM1637_DIM_RELOAD) >> 8);
+    TL1 = (uint8_t)(65536 - TM1637_DIM_RELOAD);
+    ET1 = 1;
+    TR1 = 1;
+#endif
 }
 
+// The bit level functions and the plane helpers are also used by tm1637_keys_tick()
+// and tm1637_fx_tick() which may be called from an interrupt, so their locals must
+// not be overlayed.
+#pragma save
+#pragma nooverlay
+/// @brief send the same byte to all lanes of the transaction
+/// @param b byte
 static void _write_byte(uint8_t b)
 {
-    for (int i = 0; i < 8; ++i)
+    uint8_t i;
+    PROF_BEGIN(PROF_TM_BYTE);
+    for (i = 8; i; i--, b >>= 1)
     {
-        pin_dta = (b >> i) & 1;
-        _delay();
+        // transmit 8 bits, LSB first, data is latched on the rising edge of CLK
+        if (b & 1)
+            DIO_set(m_lanes);
+        else
+            DIO_clr(m_lanes);
+        TM1637_DELAY();
         pin_clk = 1;
-        _delay();
+        TM1637_DELAY();
         pin_clk = 0;
-        _delay();
     }
+    // 9th clock for the ACK bit: the TM1637 pulls DIO low, so drive it low as well
+    DIO_clr(m_lanes);
+    TM1637_DELAY();
+    pin_clk = 1;
+    TM1637_DELAY();
     pin_clk = 0;
-    _delay();
+    PROF_END(PROF_TM_BYTE);
+}
+
+/// @brief send m_planes, a different byte on every lane. Every byte starts with
+///        DIO low (after START or ACK), so only the changing lanes are toggled.
+static void _write_planes(void)
+{
+    uint8_t i, dio = 0;
+    for (i = 0; i < 8; i++)
+    {
+        DIO_xor(dio ^ m_planes[i]);
+        dio = m_planes[i];
+        TM1637_DELAY();
+        pin_clk = 1;
+        TM1637_DELAY();
+        pin_clk = 0;
+    }
+    DIO_clr(m_lanes);
+    TM1637_DELAY();
     pin_clk = 1;
-    _delay();
+    TM1637_DELAY();
     pin_clk = 0;
-    _delay();
 }
 
-static void _start(void)
+/// @brief add the byte of one lane to m_planes
+/// @param lane lane mask
+/// @param b byte
+static void _plane_add(uint8_t lane, uint8_t b)
 {
-    pin_dta = 0;
-    _delay();
+    for (uint8_t i = 0; i < 8; ++i, b >>= 1)
+    {
+        if (b & 1)
+        {
+            m_planes[i] |= lane;
+        }
+    }
+}
+
+static void _plane_clear(void)
+{
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        m_planes[i] = 0;
+    }
+}
+#pragma restore
+
+// Transactions are started from interrupts as well (key scan, effects, dimming).
+// The interrupts skip while m_busy is set, but a foreground call may be preempted
+// before _start() sets it, so the functions up to there keep their parameters on
+// the stack.
+static void _start(uint8_t lanes) __reentrant
+{
+#ifdef TM1637_ASYNC_US
+    while (m_async)
+        ; // wait for tm1637_flush_async() to complete
+#endif
+    m_busy = 1;
+    m_lanes = lanes;
+    DIO_clr(lanes);
+    TM1637_DELAY();
     pin_clk = 0;
-    _delay();
 }
 
 static void _stop(void)
 {
-    pin_dta = 0;
-    _delay();
+    DIO_clr(m_lanes);
+    TM1637_DELAY();
     pin_clk = 1;
-    _delay();
-    pin_dta = 1;
-    _delay();
+    TM1637_DELAY();
+    DIO_set(m_lanes);
+    TM1637_DELAY();
+    m_busy = 0;
 }
 
-static void _write_data_cmd(void)
+static void _write_data_cmd(uint8_t lanes) __reentrant
 {
-    _start();
+    _start(lanes);
     _write_byte(TM1637_CMD1);
     _stop();
 }
 
-static void _write_dsp_ctrl(void)
+/// @brief send the display control with the brightness of every module in lanes
+static void _write_dsp_ctrl(uint8_t lanes) __reentrant
+{
+    _start(lanes); // sets m_busy, the interrupts leave m_planes alone from here
+    _plane_clear();
+    for (uint8_t i = 0; i < TM1637_MODULES; ++i)
+    {
+        if (lanes & m_lane[i])
+        {
+            _plane_add(m_lane[i], TM1637_CMD3 | TM1637_DSP_ON | m_brightness[i]);
+        }
+    }
+    _write_planes();
+    _stop();
+}
+
+/// @brief write segments in logical order to a range of grids of a module in a
+///        single auto-increment transaction, segments hidden by the blink engine
+///        and digits blanked by the dimming are masked out
+/// @param module module
+/// @param seg segment data of all TM1637_DIGITS positions
+/// @param first first grid
+/// @param end grid after the last one
+static void _write_segments(uint8_t module, const uint8_t __xdata *seg, uint8_t first, uint8_t end) __reentrant
+{
+    uint8_t d;
+    _start(m_lane[module]);
+    _write_byte(TM1637_CMD2 | first);
+    for (; first < end; ++first)
+    {
+        d = TM1637_GRID(first);
+        _write_byte(TM1637_VISIBLE(module, seg, d));
+    }
+    _stop();
+}
+
+/// @brief update a segment in the framebuffer of the selected module
+/// @param pos position
+/// @param data segment data
+static void _set_segment(const uint8_t pos, const uint8_t data)
+{
+    if (pos < TM1637_DIGITS && m_segments[pos] != data)
+    {
+        m_segments[pos] = data;
+        m_dirty |= 1 << m_module;
+    }
+}
+
+/// @brief Select the module the display functions work on.
+/// @param module module number 0 to TM1637_MODULES-1
+void tm1637_select(const uint8_t module)
+{
+#if TM1637_MODULES > 1
+    if (module < TM1637_MODULES)
+    {
+        m_module = module;
+    }
+#else
+    (void)module;
+#endif
+}
+
+/// @brief Send the framebuffer of the selected module to the display if it has changed.
+///        (data command, one auto-increment burst, display control)
+void tm1637_flush(void)
+{
+    uint8_t lane = m_lane[m_module];
+    if (!(m_dirty & (1 << m_module)))
+    {
+        return;
+    }
+    _write_data_cmd(lane);
+    _write_segments(m_module, m_segments, 0, TM1637_DIGITS);
+    _write_dsp_ctrl(lane);
+    m_dirty &= ~(1 << m_module);
+}
+
+/// @brief Send the framebuffers of all changed modules in parallel, every module
+///        gets its own data on its DIO lane during the same burst.
+void tm1637_flush_all(void)
 {
-    _start();
-    _write_byte(TM1637_CMD3 | TM1637_DSP_ON | m_brightness);
+    uint8_t i, d, g, lanes = 0;
+    for (i = 0; i < TM1637_MODULES; ++i)
+    {
+        if (m_dirty & (1 << i))
+        {
+            lanes |= m_lane[i];
+        }
+    }
+    if (!lanes)
+    {
+        return;
+    }
+    _write_data_cmd(lanes);
+    _start(lanes);
+    _write_byte(TM1637_CMD2);
+    for (d = 0; d < TM1637_DIGITS; ++d)
+    {
+        _plane_clear();
+        for (i = 0; i < TM1637_MODULES; ++i)
+        {
+            if (lanes & m_lane[i])
+            {
+                g = TM1637_GRID(d);
+                _plane_add(m_lane[i], TM1637_VISIBLE(i, m_fb[i], g));
+            }
+        }
+        _write_planes();
+    }
     _stop();
+    _write_dsp_ctrl(lanes);
+    m_dirty = 0;
 }
 
-/// @brief Set the display brightness 0-7.
+/// @brief Clear the framebuffer.
+void tm1637_clear(void)
+{
+    for (uint8_t i = 0; i < TM1637_DIGITS; ++i)
+    {
+        _set_segment(i, 0);
+    }
+}
+
+/// @brief Set the display brightness 0-7 of the selected module.
 /// @param val brightness level
 void tm1637_set_brightness(const uint8_t val)
 {
     // # brightness 0 = 1/16th pulse width
     // # brightness 7 = 14/16th pulse width
-    m_brightness = val & 7;
-    _write_data_cmd();
-    _write_dsp_ctrl();
+    if (m_brightness[m_module] != (val & 7))
+    {
+        m_brightness[m_module] = val & 7;
+        _write_dsp_ctrl(m_lane[m_module]);
+    }
 }
 
-/// @brief retrieve the current brightness level
+/// @brief retrieve the current brightness level of the selected module
 /// @return current brightness level (0 - 7)
 uint8_t tm1637_brightness(void)
 {
-    return m_brightness;
+    return m_brightness[m_module];
 }
 
-/// @brief write segment to the display at a given position
-/// @param segments 7-digit segments
+/// @brief write segments to the display at a given position. Blank (0x00)
+///        segments are written like any other, the length is explicit.
 /// @param pos start position
-void tm1637_write(const char *segments, int pos)
+/// @param seg 7-digit segments
+/// @param len number of segments, clipped to the display
+void tm1637_write_n(uint8_t pos, const uint8_t *seg, uint8_t len)
 {
     // Display up to 6 segments moving right from a given position.
     // The MSB in the 2nd segment controls the colon between the 2nd
     // and 3rd segments.
-    if (pos < 0 || pos > 4)
+    for (; len && pos < TM1637_DIGITS; --len)
     {
-        return;
+        _set_segment(pos++, *seg++);
     }
-    _write_data_cmd();
-    _start();
+    tm1637_flush();
+}
 
-    _write_byte(TM1637_CMD2 | pos);
+/// @brief write constant segments from code memory to the display
+/// @param pos start position
+/// @param seg 7-digit segments
+/// @param len number of segments, clipped to the display
+void tm1637_write_n_code(uint8_t pos, const uint8_t __code *seg, uint8_t len)
+{
+    for (; len && pos < TM1637_DIGITS; --len)
+    {
+        _set_segment(pos++, *seg++);
+    }
+    tm1637_flush();
+}
 
-    for (int i = 0; i < strlen(segments); ++i)
+/// @brief write a zero terminated segment string to the display at a given
+///        position. A blank segment ends the string, use tm1637_write_n() instead.
+/// @param segments 7-digit segments
+/// @param pos start position
+void tm1637_write(const char *segments, int pos)
+{
+    if (pos < 0)
     {
-        _write_byte(segments[i]);
+        return;
     }
-    _stop();
-    _write_dsp_ctrl();
+    PROF_BEGIN(PROF_TM_WRITE);
+    tm1637_write_n(pos, (const uint8_t *)segments, strlen(segments));
+    PROF_END(PROF_TM_WRITE);
 }
 
 /// @brief Convert a character 0-9, a-f to a segment
@@ -182,74 +592,202 @@ uint8_t tm1637_encode_digit(const int digit)
     return _SEGMENTS[digit & 0x0f];
 }
 
-/// @brief Convert a character 0-9, a-z, space, dash or star to a segment.
+/// @brief Convert a character to a segment with a single table lookup.
+///        See tools/font7seg.txt for the available glyphs. The degree sign is
+///        Latin-1 '\xB0', not the two UTF-8 bytes of a degree sign in the source.
 /// @param o char / character
-/// @return Convert a character 0-9, a-z, space, dash or star to a segment.
+/// @return segments for the character, blank if the character has no glyph.
 uint8_t tm1637_encode_char(const char o)
 {
-    if (o == ' ')
+    return FONT7SEG[(uint8_t)o];
+}
+
+/// @brief encode the string into the framebuffer, unused digits are cleared
+/// @param s string
+/// @return segments for the given string
+char *tm1637_encode_string(const char *s)
+{
+    for (uint8_t i = 0; i < TM1637_DIGITS; ++i)
+    {
+        _set_segment(i, *s ? tm1637_encode_char(*s++) : 0);
+    }
+    return (char *)m_segments;
+}
+
+/// @brief Display a hex value 0x0000 through 0xffff, right aligned.
+/// @param val
+/// @return hexadecimal representation for the value as 7digit segments
+char *tm1637_hex(uint16_t val)
+{
+    uint8_t pos = TM1637_DIGITS;
+    for (uint8_t i = 0; i < 4; ++i, val >>= 4)
     {
-        return _SEGMENTS[36];
-    } // #space
-    else if (o == 42)
+        _set_segment(--pos, _SEGMENTS[val & 0x0f]);
+    }
+    while (pos)
     {
-        return _SEGMENTS[38];
-    } // # star/degrees
-    else if (o == 45)
+        _set_segment(--pos, 0);
+    }
+    return (char *)m_segments;
+}
+
+/// @brief Split a value below 1000000 into 6 decimal digits without division.
+///        Each digit takes at most 9 subtractions.
+/// @param val value
+/// @param dig digits, most significant first
+static void _bcd(uint32_t val, uint8_t *dig)
+{
+    uint16_t w;
+    uint8_t d;
+    for (d = 0; val >= 100000; ++d)
+        val -= 100000;
+    dig[0] = d;
+    for (d = 0; val >= 10000; ++d)
+        val -= 10000;
+    dig[1] = d;
+    w = (uint16_t)val;
+    for (d = 0; w >= 1000; ++d)
+        w -= 1000;
+    dig[2] = d;
+    for (d = 0; w >= 100; ++d)
+        w -= 100;
+    dig[3] = d;
+    for (d = 0; w >= 10; ++d)
+        w -= 10;
+    dig[4] = d;
+    dig[5] = (uint8_t)w;
+}
+
+// smallest value that does not fit into n digits
+static __code const uint32_t _LIMIT[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/// @brief Write a signed decimal value right aligned into a field of the framebuffer.
+///        Values that do not fit are shown as dashes.
+/// @param val value
+/// @param pos first position of the field
+/// @param width width of the field (at most 6)
+/// @param mindig minimum number of digits, leading zeros fill up to it
+/// @return 1 if the value fits, 0 if dashes are shown
+static uint8_t _decimal(int32_t val, uint8_t pos, uint8_t width, uint8_t mindig)
+{
+    uint8_t dig[6];
+    uint8_t neg = val < 0;
+    uint32_t v = neg ? 0u - (uint32_t)val : val; // no signed overflow at INT32_MIN
+    uint8_t end, n, i;
+
+    if (width > 6)
     {
-        return _SEGMENTS[37];
-    } // # dash
-    else if (o >= 65 && o <= 90)
+        width = 6;
+    }
+    if (!width)
     {
-        return _SEGMENTS[o - 55];
-    } // # uppercase A-Z
-    else if (o >= 97 && o <= 122)
+        return 0;
+    }
+    end = pos + width;
+    if (width - neg < 1 || v >= _LIMIT[width - neg])
     {
-        return _SEGMENTS[o - 87];
-    } // # lowercase a-z
-    else if (o >= 48 && o <= 57)
+        while (pos < end)
+        {
+            _set_segment(pos++, TM1637_MINUS);
+        }
+        return 0;
+    }
+
+    _bcd(v, dig);
+    // number of significant digits (at least one)
+    for (n = 6; n > 1 && !dig[6 - n]; --n)
+        ;
+    if (n < mindig)
     {
-        return _SEGMENTS[o - 48];
-    } // # 0-9
-    else
+        n = mindig;
+    }
+    if (n > width - neg)
+    {
+        n = width - neg;
+    }
+    for (i = 0; i < n; ++i)
     {
-        return _SEGMENTS[36];
+        _set_segment(--end, _SEGMENTS[dig[5 - i]]);
     }
+    if (neg)
+    {
+        _set_segment(--end, TM1637_MINUS);
+    }
+    while (end > pos)
+    {
+        _set_segment(--end, 0);
+    }
+    return 1;
 }
 
-/// @brief encode the string into segments
-/// @param s string
-/// @return segments for the given string
-char *tm1637_encode_string(const char *s)
+/// @brief Write a signed decimal value right aligned into a field of the framebuffer.
+///        Values that do not fit are shown as dashes.
+/// @param val value
+/// @param pos first position of the field
+/// @param width width of the field (at most 6)
+/// @param flags TM1637_ZEROS to keep leading zeros
+void tm1637_decimal(int32_t val, uint8_t pos, uint8_t width, uint8_t flags)
 {
-    memset(m_segments, 0, sizeof(m_segments));
-    for (uint8_t i = 0; i < strlen(s); ++i)
+    _decimal(val, pos, width, flags & TM1637_ZEROS ? width : 1);
+}
+
+/// @brief Write a fixed-point value right aligned into a field of the framebuffer,
+///        the decimal point is the dot segment of the last integer digit.
+///        e.g. tm1637_fixed(-125, 1, 0, 4) shows "-12.5"
+/// @param val value in units of 10^-decimals
+/// @param decimals number of fractional digits
+/// @param pos first position of the field
+/// @param width width of the field (at most 6)
+/// @return 1 if the value fits, 0 if dashes are shown
+uint8_t tm1637_fixed(int32_t val, uint8_t decimals, uint8_t pos, uint8_t width)
+{
+    if (decimals >= width || !_decimal(val, pos, width, decimals + 1))
     {
-        m_segments[i] = tm1637_encode_char(s[i]);
+        return 0;
     }
-    return m_segments;
+    if (decimals)
+    {
+        pos += width - 1 - decimals;
+        _set_segment(pos, m_segments[pos] | TM1637_MSB);
+    }
+    return 1;
 }
 
-/// @brief Display a hex value 0x0000 through 0xffff, right aligned.
-/// @param val
-/// @return hexadecimal representation for the value as 7digit segments
-char *tm1637_hex(uint16_t val)
+/// @brief Write a temperature followed by the degree sign into the framebuffer,
+///        e.g. "-12.5°" on 6 digits. Without room for the tenths the whole
+///        degrees are shown ("-13°" on 4 digits).
+/// @param tenths temperature in 0.1 degrees
+void tm1637_temperature(int16_t tenths)
+{
+    if (!tm1637_fixed(tenths, 1, 0, TM1637_DIGITS - 1))
+    {
+        // round half away from zero
+        _decimal(((int32_t)tenths + (tenths < 0 ? -5 : 5)) / 10, 0, TM1637_DIGITS - 1, 1);
+    }
+    _set_segment(TM1637_DIGITS - 1, TM1637_DEGREE);
+}
+
+/// @brief Write a time as HH:MM into positions 0-3 of the framebuffer.
+/// @param hh hours
+/// @param mm minutes
+/// @param flags TM1637_ZEROS for a leading zero of the hours, TM1637_COLON for the colon
+void tm1637_clock(uint8_t hh, uint8_t mm, uint8_t flags)
 {
-    char s[10];
-    sprintf(s, "%.4x", val);
-    s[4] = 0;
-    return tm1637_encode_string(s);
+    _decimal(hh, 0, 2, flags & TM1637_ZEROS ? 2 : 1);
+    _decimal(mm, 2, 2, 2);
+    if (flags & TM1637_COLON)
+    {
+        _set_segment(1, m_segments[1] | TM1637_MSB);
+    }
 }
 
-/// @brief number
+/// @brief Display a signed decimal value zero padded to all digits, like "%.4d".
 /// @param val
 /// @return decimal representation of the input value as segments
-const char *tm1637_number(uint16_t val)
+const char *tm1637_number(int32_t val)
 {
-    char s[10];
-    sprintf(s, "%.4d", val);
-    s[4] = 0;
-    return tm1637_encode_string(s);
+    tm1637_decimal(val, 0, TM1637_DIGITS, TM1637_ZEROS);
+    return (const char *)m_segments;
 }
 
 /// @brief show a string on the display
@@ -257,32 +795,29 @@ const char *tm1637_number(uint16_t val)
 /// @param colon show colon (default false). Colon is not available on all displays.
 void tm1637_show(const char *s, __bit colon)
 {
-    tm1637_encode_string(s);
+    uint8_t seg[TM1637_DIGITS];
+    for (uint8_t i = 0; i < TM1637_DIGITS; ++i)
+    {
+        seg[i] = *s ? tm1637_encode_char(*s++) : 0;
+    }
     if (colon)
     {
-        m_segments[1] |= 128;
+        seg[1] |= TM1637_MSB;
     }
-    tm1637_write(m_segments, 0);
+    tm1637_write_n(0, seg, TM1637_DIGITS);
 }
 
-/// @brief set the raw segment at a given position
+/// @brief set the raw segment at a given position in the framebuffer,
+///        call tm1637_flush() to update the display
 /// @param pos desired position
 /// @param data segment data
 void tm1637_set_raw(const uint8_t pos, const uint8_t data)
 {
-    _start();
-    _write_byte(TM1637_ADDR_FIXED);
-    _stop();
-    _start();
-    _write_byte(pos | 0xc0);
-    _write_byte(data);
-    _stop();
-    _start();
-    _write_byte(m_brightness | 0x88);
-    _stop();
+    _set_segment(pos, data);
 }
 
-/// @brief set a character at a given position
+/// @brief set a character at a given position in the framebuffer,
+///        call tm1637_flush() to update the display
 /// @param pos desired position
 /// @param ch ascii char
 /// @param dot enable dot at this position (default false)
@@ -295,3 +830,696 @@ void tm1637_set_char(const uint8_t pos, const char ch, const uint8_t dot)
     }
     tm1637_set_raw(pos, data);
 }
+
+// ===================================================================================
+// Marquee
+// ===================================================================================
+// tm1637_marquee_set() encodes a message once into a segment stream in XRAM, framed
+// by a blank display width on both sides, so the text scrolls in from the right and
+// out to the left. tm1637_marquee_step() shows the next window with a single
+// auto-increment transaction: the driver always leaves the TM1637 in auto-increment
+// write mode, so neither the data command nor the display control is repeated.
+
+#ifndef TM1637_MARQUEE_MAX
+#define TM1637_MARQUEE_MAX 48 // maximum number of encoded message positions
+#endif
+
+static uint8_t __xdata m_marquee[TM1637_MARQUEE_MAX + 2 * TM1637_DIGITS];
+static uint8_t __xdata m_marquee_len; // number of window positions
+static uint8_t __xdata m_marquee_pos; // current window position
+
+/// @brief Encode a message for scrolling. A '.' is merged into the decimal point
+///        of the preceding character.
+/// @param msg message
+/// @return number of encoded message positions
+uint8_t tm1637_marquee_set(const char *msg)
+{
+    uint8_t n = TM1637_DIGITS;
+    for (uint8_t i = 0; i < TM1637_DIGITS; ++i)
+    {
+        m_marquee[i] = 0;
+    }
+    for (; *msg && n < TM1637_MARQUEE_MAX + TM1637_DIGITS; ++msg)
+    {
+        if (*msg == '.' && n > TM1637_DIGITS && !(m_marquee[n - 1] & TM1637_MSB))
+        {
+            m_marquee[n - 1] |= TM1637_MSB;
+        }
+        else
+        {
+            m_marquee[n++] = tm1637_encode_char(*msg);
+        }
+    }
+    for (uint8_t i = 0; i < TM1637_DIGITS; ++i)
+    {
+        m_marquee[n++] = 0;
+    }
+    // the last window is blank like the first one, so it is skipped when wrapping
+    m_marquee_len = n - TM1637_DIGITS;
+    m_marquee_pos = 0;
+    return n - 2 * TM1637_DIGITS;
+}
+
+/// @brief Show the next window of the message (one burst, no re-encoding).
+/// @return 1 after a complete pass of the message, 0 otherwise
+uint8_t tm1637_marquee_step(void)
+{
+    if (!m_marquee_len)
+    {
+        return 1;
+    }
+    _write_segments(m_module, &m_marquee[m_marquee_pos], 0, TM1637_DIGITS);
+    m_dirty |= 1 << m_module; // the display no longer shows the framebuffer
+    if (++m_marquee_pos >= m_marquee_len)
+    {
+        m_marquee_pos = 0;
+        return 1;
+    }
+    return 0;
+}
+
+// ===================================================================================
+// Interrupt Driven Transmission
+// ===================================================================================
+// With TM1637_ASYNC_US defined, tm1637_flush_async() prepares the three transactions
+// of a flush (data command, burst, display control) as a frame of length-prefixed
+// packets and Timer1 clocks it out: every interrupt makes one step, the half bit
+// period is TM1637_ASYNC_US. The CPU runs between the edges, which pays off once the
+// half period is well above the ~40 cycles of the interrupt (e.g. 10us at 16MHz).
+// Blocking transactions wait for a running frame, tm1637_async_busy() tells when it
+// is done. Global interrupts (EA) must be enabled by the application.
+
+#ifdef TM1637_ASYNC_US
+enum
+{
+    TM1637_ISR_START, // DIO low while CLK is high
+    TM1637_ISR_LOW,   // CLK low, then the next data bit on DIO
+    TM1637_ISR_HIGH,  // CLK high, the TM1637 latches the bit
+    TM1637_ISR_STOP,  // CLK high while DIO is low
+    TM1637_ISR_IDLE   // DIO high, next packet or done
+};
+
+static uint8_t __xdata m_frame[TM1637_DIGITS + 7]; // packets: length, bytes...; 0 ends
+static uint8_t __data m_isr_state;
+static uint8_t __data m_isr_pos;  // next frame byte
+static uint8_t __data m_isr_left; // bytes left in the packet + 1
+static uint8_t __data m_isr_byte; // byte being sent, shifted LSB first
+static uint8_t __data m_isr_bit;  // bit of the byte, 8 is the ACK clock
+
+/// @brief Timer1 interrupt: one step of the frame
+void TM1637_interrupt(void) __interrupt(INT_NO_TMR1)
+{
+    switch (m_isr_state)
+    {
+    case TM1637_ISR_START:
+        DIO_clr(m_lanes);
+        m_isr_state = TM1637_ISR_LOW;
+        break;
+    case TM1637_ISR_LOW:
+        pin_clk = 0;
+        if (++m_isr_bit == 9)
+        {
+            if (!--m_isr_left)
+            {
+                m_isr_state = TM1637_ISR_STOP; // DIO is still low from the ACK
+                break;
+            }
+            m_isr_bit = 0;
+            m_isr_byte = m_frame[m_isr_pos++];
+        }
+        else
+        {
+            m_isr_byte >>= 1;
+        }
+        if (m_isr_bit != 8 && (m_isr_byte & 1))
+            DIO_set(m_lanes);
+        else
+            DIO_clr(m_lanes);
+        m_isr_state = TM1637_ISR_HIGH;
+        break;
+    case TM1637_ISR_HIGH:
+        pin_clk = 1;
+        m_isr_state = TM1637_ISR_LOW;
+        break;
+    case TM1637_ISR_STOP:
+        pin_clk = 1;
+        m_isr_state = TM1637_ISR_IDLE;
+        break;
+    default:
+        DIO_set(m_lanes);
+        m_isr_left = m_frame[m_isr_pos++];
+        if (m_isr_left)
+        {
+            m_isr_left++;
+            m_isr_bit = 8; // the first LOW step loads the first byte
+            m_isr_state = TM1637_ISR_START;
+        }
+        else
+        {
+            TR1 = 0;
+            m_busy = 0;
+            m_async = 0;
+        }
+        break;
+    }
+}
+
+/// @brief Start sending the framebuffer of the selected module from the Timer1
+///        interrupt if it has changed.
+/// @return 1 if started or nothing to send, 0 if the previous frame is still running
+uint8_t tm1637_flush_async(void)
+{
+    uint8_t __xdata *f = m_frame;
+    uint8_t g, d;
+    if (m_async)
+    {
+        return 0;
+    }
+    if (!(m_dirty & (1 << m_module)))
+    {
+        return 1;
+    }
+    *f++ = 1;
+    *f++ = TM1637_CMD1;
+    *f++ = TM1637_DIGITS + 1;
+    *f++ = TM1637_CMD2;
+    for (g = 0; g < TM1637_DIGITS; ++g)
+    {
+        d = TM1637_GRID(g);
+        *f++ = TM1637_VISIBLE(m_module, m_segments, d);
+    }
+    *f++ = 1;
+    *f++ = TM1637_CMD3 | TM1637_DSP_ON | m_brightness[m_module];
+    *f = 0;
+    m_dirty &= ~(1 << m_module);
+
+    m_busy = 1;
+    m_lanes = m_lane[m_module];
+    m_isr_pos = 0;
+    m_isr_state = TM1637_ISR_IDLE; // the first step loads the first packet
+    m_async = 1;
+    TL1 = (uint8_t)(256 - TM1637_ASYNC_RELOAD);
+    TR1 = 1;
+    return 1;
+}
+
+/// @brief Check whether tm1637_flush_async() is still sending.
+/// @return 1 while the frame is being sent
+uint8_t tm1637_async_busy(void)
+{
+    return m_async;
+}
+#endif
+
+// ===================================================================================
+// Per-Digit Dimming
+// ===================================================================================
+// With TM1637_DIM_HZ defined, the Timer1 interrupt shows TM1637_DIM_LEVELS frames
+// per refresh cycle. A digit at level n is lit in the first n frames and blanked in
+// the others, on top of the global brightness. A frame is sent only when a digit
+// changes, as a burst over the grids that change, with the blocking bit path at
+// TM1637_BIT_US. The interrupt drops frames that hit a display transaction.
+// tm1637_dim_rate() reports the refresh rate actually achieved. 800Hz frames with
+// 4 levels give a 200Hz refresh, and a 4-digit burst at 2us takes ~0.2ms.
+// Global interrupts (EA) must be enabled by the application.
+
+#ifdef TM1637_DIM_HZ
+static uint8_t __data m_dim_phase;      // frame in the refresh cycle
+static uint16_t __xdata m_dim_frames;   // frame interrupts since the last report
+static uint16_t __xdata m_dim_cycles;   // complete refresh cycles since the last report
+
+/// @brief Timer1 interrupt: next dimming frame
+void TM1637_DIM_interrupt(void) __interrupt(INT_NO_TMR1)
+{
+    uint8_t d, g, dark = 0, first = TM1637_DIGITS, end = 0;
+    TH1 = (uint8_t)((65536 - TM1637_DIM_RELOAD) >> 8);
+    TL1 = (uint8_t)(65536 - TM1637_DIM_RELOAD);
+    if (++m_dim_frames & 0x8000)
+    {
+        // keep the ratio if nobody asks for the rate
+        m_dim_frames >>= 1;
+        m_dim_cycles >>= 1;
+    }
+    if (m_busy)
+    {
+        return; // frame dropped
+    }
+    if (++m_dim_phase >= TM1637_DIM_LEVELS)
+    {
+        m_dim_phase = 0;
+        m_dim_cycles++;
+    }
+    for (g = 0; g < TM1637_DIGITS; ++g)
+    {
+        d = TM1637_GRID(g);
+        if (m_dim_phase >= m_dim[d])
+        {
+            dark |= 1 << d;
+        }
+        if ((dark ^ m_dark) & (1 << d))
+        {
+            if (first > g)
+            {
+                first = g;
+            }
+            end = g + 1;
+        }
+    }
+    if (first < end)
+    {
+        m_dark = dark;
+        _write_segments(m_fx_module, m_fb[m_fx_module], first, end);
+    }
+}
+
+/// @brief Set the brightness of a digit of the selected module.
+/// @param pos position
+/// @param level 0 (off) to TM1637_DIM_LEVELS (full)
+void tm1637_dim(const uint8_t pos, const uint8_t level)
+{
+    if (pos < TM1637_DIGITS)
+    {
+#if TM1637_MODULES > 1
+        m_fx_module = m_module;
+#endif
+        m_dim[pos] = level > TM1637_DIM_LEVELS ? TM1637_DIM_LEVELS : level;
+    }
+}
+
+/// @brief Report the refresh rate achieved since the last call.
+/// @return complete refresh cycles per second
+uint16_t tm1637_dim_rate(void)
+{
+    uint32_t rate = 0;
+    ET1 = 0;
+    if (m_dim_frames)
+    {
+        rate = (uint32_t)m_dim_cycles * TM1637_DIM_HZ / m_dim_frames;
+    }
+    m_dim_frames = 0;
+    m_dim_cycles = 0;
+    ET1 = 1;
+    return (uint16_t)rate;
+}
+#endif
+
+// ===================================================================================
+// Fade, Blink and Animation
+// ===================================================================================
+// tm1637_fx_tick() runs the effects of the module selected when they were started.
+// Call it at a fixed rate (e.g. every 10ms) from a timer interrupt or the main loop.
+// A fade steps the brightness evenly towards its target and sends one display
+// control per level. Blinking toggles the selected segments of some digits (0xff
+// for the whole digit, 0x80 for the dot/colon) and rewrites only the grids whose
+// visible segments change. Like the key scan, a tick that hits a display
+// transaction is postponed to the next one.
+//
+// Animations are keyframe tables in code memory. Every frame is a duration in ticks
+// followed by the segments of the TM1637_DIGITS positions, a duration of 0 ends the
+// table:
+//   __code const uint8_t spinner[] = {10, 0x01, 0, 0, 0,  10, 0, 0x01, 0, 0,  0};
+// Frames are copied into the framebuffer and only the changed grids are sent.
+
+static uint8_t __xdata m_fade_to;        // target brightness
+static uint8_t __xdata m_fade_interval;  // ticks per brightness level
+static uint8_t __xdata m_fade_count;     // ticks until the next level
+static uint8_t __xdata m_blink[TM1637_DIGITS]; // blinking segments per digit
+static uint8_t __xdata m_blink_period;   // ticks per blink phase, 0: off
+static uint8_t __xdata m_blink_count;    // ticks until the next phase
+static __bit m_blink_off;                // blinking segments are hidden
+
+static const uint8_t __code *__xdata m_anim_start; // first frame
+static const uint8_t __code *__xdata m_anim_frame; // next frame, 0: stopped, written in __critical
+static uint8_t __xdata m_anim_count;               // ticks until the next frame
+static uint8_t __xdata m_anim_loops;               // passes left, 0: forever
+
+/// @brief Ramp the brightness of the selected module to a level.
+/// @param level target brightness 0-7
+/// @param ticks duration in ticks
+void tm1637_fade(const uint8_t level, const uint16_t ticks)
+{
+    uint8_t to = level & 7;
+    uint8_t cur = m_brightness[m_module];
+    uint8_t steps = to > cur ? to - cur : cur - to;
+    uint16_t interval;
+    m_fade_count = 0; // stop a running fade while the parameters change
+#if TM1637_MODULES > 1
+    m_fx_module = m_module;
+#endif
+    if (!steps)
+    {
+        return;
+    }
+    interval = ticks / steps;
+    m_fade_interval = !interval ? 1 : interval > 255 ? 255 : interval;
+    m_fade_to = to;
+    m_fade_count = m_fade_interval;
+}
+
+/// @brief Blink segments of a digit of the selected module.
+/// @param pos position
+/// @param mask segments to blink, 0xff for the whole digit, 0 to stop
+/// @param period ticks per on/off phase, shared by all blinking digits
+void tm1637_blink(const uint8_t pos, const uint8_t mask, const uint8_t period)
+{
+    uint8_t hide, d;
+    if (pos >= TM1637_DIGITS)
+    {
+        return;
+    }
+#if TM1637_MODULES > 1
+    m_fx_module = m_module;
+#endif
+    m_blink[pos] = mask;
+    if (mask)
+    {
+        m_blink_period = period;
+        if (!m_blink_count || m_blink_count > period)
+        {
+            m_blink_count = period;
+        }
+    }
+    else
+    {
+        for (d = 0; d < TM1637_DIGITS && !m_blink[d]; ++d)
+            ;
+        if (d == TM1637_DIGITS)
+        {
+            m_blink_period = 0; // last blinking digit stopped, stop the tick
+            m_blink_count = 0;
+            m_blink_off = 0;
+        }
+    }
+    hide = m_blink_off ? mask : 0;
+    if (m_hide[pos] != hide)
+    {
+        // follow the current phase, the next flush shows the change
+        m_hide[pos] = hide;
+        m_dirty |= 1 << m_fx_module;
+    }
+}
+
+/// @brief Check whether a fade is running.
+/// @return 1 while the brightness is changing
+uint8_t tm1637_fading(void)
+{
+    return m_fade_count != 0;
+}
+
+/// @brief Play a keyframe animation on the selected module.
+/// @param anim keyframe table
+/// @param loops number of passes, 0 to repeat until tm1637_anim_stop()
+void tm1637_anim_play(const uint8_t __code *anim, const uint8_t loops)
+{
+    tm1637_anim_stop(); // stop the tick while the parameters change
+    if (!*anim)
+    {
+        return;
+    }
+#if TM1637_MODULES > 1
+    m_fx_module = m_module;
+#endif
+    m_anim_start = anim;
+    m_anim_loops = loops;
+    m_anim_count = 1; // first frame on the next tick
+    __critical
+    {
+        m_anim_frame = anim; // two bytes, the tick may run in an interrupt
+    }
+}
+
+/// @brief Stop the animation, the last frame stays in the framebuffer.
+void tm1637_anim_stop(void)
+{
+    __critical
+    {
+        m_anim_frame = 0;
+    }
+}
+
+/// @brief Check whether an animation is playing.
+/// @return 1 while playing
+uint8_t tm1637_anim_playing(void)
+{
+    uint8_t playing;
+    __critical
+    {
+        playing = m_anim_frame != 0;
+    }
+    return playing;
+}
+
+/// @brief show the next animation frame when it is due
+/// @param fb framebuffer of the animated module
+static void _anim_tick(uint8_t __xdata *fb)
+{
+    const uint8_t __code *f = m_anim_frame;
+    uint8_t d, g, first, end;
+    if (!f || --m_anim_count)
+    {
+        return;
+    }
+    if (!*f)
+    {
+        if (m_anim_loops && !--m_anim_loops)
+        {
+            m_anim_frame = 0;
+            return;
+        }
+        f = m_anim_start;
+    }
+    m_anim_count = *f++;
+    first = TM1637_DIGITS;
+    end = 0;
+    for (g = 0; g < TM1637_DIGITS; ++g)
+    {
+        d = TM1637_GRID(g);
+        if (fb[d] != f[d])
+        {
+            fb[d] = f[d];
+            if (first > g)
+            {
+                first = g;
+            }
+            end = g + 1;
+        }
+    }
+    m_anim_frame = f + TM1637_DIGITS;
+    if (m_dirty & (1 << m_fx_module))
+    { // the display is behind the framebuffer, unchanged digits are due as well
+        first = 0;
+        end = TM1637_DIGITS;
+        m_dirty &= ~(1 << m_fx_module);
+    }
+    if (first < end)
+    {
+        _write_segments(m_fx_module, fb, first, end);
+    }
+}
+
+/// @brief Advance the fade, blink and animation effects by one tick.
+void tm1637_fx_tick(void)
+{
+    uint8_t d, g, first, end;
+    uint8_t __xdata *fb = m_fb[m_fx_module];
+    if (m_busy)
+    {
+        return; // interrupted a display transaction, retry on the next tick
+    }
+
+    if (m_fade_count && !--m_fade_count)
+    {
+        d = m_brightness[m_fx_module];
+        if (m_fade_to > d)
+        {
+            ++d;
+        }
+        else if (m_fade_to < d)
+        {
+            --d;
+        }
+        m_brightness[m_fx_module] = d;
+        _write_dsp_ctrl(m_lane[m_fx_module]);
+        if (d != m_fade_to)
+        {
+            m_fade_count = m_fade_interval;
+        }
+    }
+
+    if (m_blink_period && !--m_blink_count)
+    {
+        m_blink_count = m_blink_period;
+        m_blink_off = !m_blink_off;
+        first = TM1637_DIGITS;
+        end = 0;
+        for (g = 0; g < TM1637_DIGITS; ++g)
+        {
+            d = TM1637_GRID(g);
+            m_hide[d] = m_blink_off ? m_blink[d] : 0;
+            if (m_blink[d] & fb[d])
+            {
+                // the visible segments of this grid change
+                if (first > g)
+                {
+                    first = g;
+                }
+                end = g + 1;
+            }
+        }
+        if (first < end)
+        {
+            _write_segments(m_fx_module, fb, first, end);
+        }
+    }
+
+    _anim_tick(fb);
+}
+
+// ===================================================================================
+// Key Scan
+// ===================================================================================
+// The TM1637 scans a 2x8 key matrix (K1/K2 x SG1..SG8). tm1637_keys_tick() reads
+// the key register, debounces it and queues press/release/long-press events. It is
+// meant to be called every ~10ms from a timer interrupt or the main loop. When the
+// interrupt hits a display transaction, the sample is skipped. With several modules
+// the keys are read from TM1637_KEY_MODULE.
+
+#ifndef TM1637_KEY_DEBOUNCE
+#define TM1637_KEY_DEBOUNCE 3 // ticks a key must be stable
+#endif
+#ifndef TM1637_KEY_LONG
+#define TM1637_KEY_LONG 100 // ticks until a long press is reported
+#endif
+#ifndef TM1637_KEY_MODULE
+#define TM1637_KEY_MODULE 0 // module with the key matrix
+#endif
+#define TM1637_KEY_QUEUE 8 // event queue size, must be a power of 2
+
+static uint8_t __xdata m_key_sample = TM1637_KEY_NONE; // last sampled key
+static uint8_t __xdata m_key_stable = TM1637_KEY_NONE; // debounced key
+static uint8_t __xdata m_key_count;                    // ticks the sample is unchanged
+static uint16_t __xdata m_key_held;                    // ticks the stable key is held
+static uint8_t __xdata m_key_queue[TM1637_KEY_QUEUE];
+static uint8_t __xdata m_key_head; // written by tm1637_keys_tick()
+static uint8_t __xdata m_key_tail; // read by tm1637_key_event()
+
+#pragma save
+#pragma nooverlay
+/// @brief read one byte from the TM1637, LSB first
+/// @return received byte
+static uint8_t _read_byte(void)
+{
+    uint8_t i, b = 0;
+    DIO_input_PU(m_lanes); // release DIO, the TM1637 drives the key data
+    DIO_set(m_lanes);
+    for (i = 8; i; i--)
+    {
+        // data changes after the falling edge of CLK and is read while CLK is high
+        b >>= 1;
+        TM1637_DELAY();
+        pin_clk = 1;
+        TM1637_DELAY();
+        if (DIO_read() & m_lanes)
+        {
+            b |= 0x80;
+        }
+        pin_clk = 0;
+    }
+    // 9th clock for the ACK bit
+    TM1637_DELAY();
+    pin_clk = 1;
+    TM1637_DELAY();
+    pin_clk = 0;
+    DIO_output(m_lanes);
+    return b;
+}
+
+/// @brief queue a key event, the oldest event is kept if the queue is full
+/// @param event event
+static void _key_push(uint8_t event)
+{
+    if ((uint8_t)(m_key_head - m_key_tail) < TM1637_KEY_QUEUE)
+    {
+        m_key_queue[m_key_head & (TM1637_KEY_QUEUE - 1)] = event;
+        m_key_head++;
+    }
+}
+#pragma restore
+
+/// @brief Read the raw key scan register.
+/// @return key number 0-15 (K1: SG1..SG8 = 0..7, K2: SG1..SG8 = 8..15) or TM1637_KEY_NONE
+uint8_t tm1637_key_read(void)
+{
+    uint8_t raw;
+    _start(m_lane[TM1637_KEY_MODULE]);
+    _write_byte(TM1637_READ_KEYS);
+    raw = _read_byte();
+    _stop();
+    _write_data_cmd(m_lane[TM1637_KEY_MODULE]); // back to write mode for the display transactions
+
+    switch (raw & 0x18)
+    {
+    case 0x10: // K1
+        return 7 - (raw & 7);
+    case 0x08: // K2
+        return 15 - (raw & 7);
+    default: // no key or invalid code
+        return TM1637_KEY_NONE;
+    }
+}
+
+/// @brief Sample and debounce the keys, queue the resulting events.
+///        Call every ~10ms, from a timer interrupt or the main loop.
+void tm1637_keys_tick(void)
+{
+    uint8_t key;
+    if (m_busy)
+    {
+        return; // interrupted a display transaction, skip this sample
+    }
+    key = tm1637_key_read();
+    if (key != m_key_sample)
+    {
+        m_key_sample = key;
+        m_key_count = 0;
+    }
+    else if (m_key_count < TM1637_KEY_DEBOUNCE)
+    {
+        if (++m_key_count == TM1637_KEY_DEBOUNCE && key != m_key_stable)
+        {
+            if (m_key_stable != TM1637_KEY_NONE)
+            {
+                _key_push(TM1637_KEY_RELEASE | m_key_stable);
+            }
+            if (key != TM1637_KEY_NONE)
+            {
+                _key_push(TM1637_KEY_PRESS | key);
+            }
+            m_key_stable = key;
+            m_key_held = 0;
+        }
+    }
+
+    if (m_key_stable != TM1637_KEY_NONE && m_key_held < TM1637_KEY_LONG)
+    {
+        if (++m_key_held == TM1637_KEY_LONG)
+        {
+            _key_push(TM1637_KEY_LONGPRESS | m_key_stable);
+        }
+    }
+}
+
+/// @brief Get the next key event.
+/// @return TM1637_KEY_PRESS, TM1637_KEY_RELEASE or TM1637_KEY_LONGPRESS combined with
+///         the key number, or 0 if there is no event.
+uint8_t tm1637_key_event(void)
+{
+    uint8_t event;
+    if (m_key_head == m_key_tail)
+    {
+        return 0;
+    }
+    event = m_key_queue[m_key_tail & (TM1637_KEY_QUEUE - 1)];
+    m_key_tail++;
+    return event;
+}
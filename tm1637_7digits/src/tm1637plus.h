@@ -34,5 +34,60 @@ SOFTWARE.
 void tm1637_init(void);
 void tm1637_set_brightness(const uint8_t val);
 void tm1637_show(const char *s, __bit colon);
+void tm1637_write_n(uint8_t pos, const uint8_t *seg, uint8_t len);
+void tm1637_write_n_code(uint8_t pos, const uint8_t __code *seg, uint8_t len);
 void tm1637_set_raw(const uint8_t pos, const uint8_t data);
-void tm1637_set_char(const uint8_t pos, const char ch, const uint8_t dot);
\ No newline at end of file
+void tm1637_set_char(const uint8_t pos, const char ch, const uint8_t dot);
+void tm1637_clear(void);
+void tm1637_flush(void);
+void tm1637_select(const uint8_t module);
+void tm1637_flush_all(void);
+
+// The async transmitter and the dimming take over Timer1, which is also the baud
+// rate generator of UART0. Timer2 is taken as well, it is the free running Fsys
+// counter of DLY_us(), the I2C trace and the profiler. Use UART0 in mode 2 (fixed
+// Fsys/32 or Fsys/128 rate) or UART1 (SBAUD1) instead; with UART_BAUD (UART0 on
+// Timer1, or on Timer2 with UART_TIMER 2) in config.h the build stops.
+#ifdef TM1637_ASYNC_US
+uint8_t tm1637_flush_async(void);
+uint8_t tm1637_async_busy(void);
+void TM1637_interrupt(void) __interrupt(INT_NO_TMR1);
+#endif
+
+#ifdef TM1637_DIM_HZ
+void tm1637_dim(const uint8_t pos, const uint8_t level);
+uint16_t tm1637_dim_rate(void);
+void TM1637_DIM_interrupt(void) __interrupt(INT_NO_TMR1);
+#endif
+
+#define TM1637_ZEROS 0x01 // tm1637_decimal(), tm1637_clock(): keep leading zeros
+#define TM1637_COLON 0x02 // tm1637_clock(): show the colon
+
+void tm1637_decimal(int32_t val, uint8_t pos, uint8_t width, uint8_t flags);
+const char *tm1637_number(int32_t val);
+char *tm1637_hex(uint16_t val);
+uint8_t tm1637_fixed(int32_t val, uint8_t decimals, uint8_t pos, uint8_t width);
+void tm1637_temperature(int16_t tenths);
+void tm1637_clock(uint8_t hh, uint8_t mm, uint8_t flags);
+
+uint8_t tm1637_marquee_set(const char *msg);
+uint8_t tm1637_marquee_step(void);
+
+void tm1637_fade(const uint8_t level, const uint16_t ticks);
+void tm1637_blink(const uint8_t pos, const uint8_t mask, const uint8_t period);
+uint8_t tm1637_fading(void);
+void tm1637_anim_play(const uint8_t __code *anim, const uint8_t loops);
+void tm1637_anim_stop(void);
+uint8_t tm1637_anim_playing(void);
+void tm1637_fx_tick(void);
+
+#define TM1637_KEY_NONE 0xff        // tm1637_key_read(): no key pressed
+#define TM1637_KEY_PRESS 0x40       // key events: type | key number (0-15)
+#define TM1637_KEY_RELEASE 0x80
+#define TM1637_KEY_LONGPRESS 0xc0
+#define TM1637_KEY_TYPE(event) ((event) & 0xc0)
+#define TM1637_KEY_CODE(event) ((event) & 0x0f)
+
+uint8_t tm1637_key_read(void);
+void tm1637_keys_tick(void);
+uint8_t tm1637_key_event(void);
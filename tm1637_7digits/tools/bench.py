@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# ===================================================================================
+# Run a bench firmware headless in ucsim and report the cycles as JSON
+# ===================================================================================
+#
+# Usage: python3 bench.py [--s51 s51] [--fcpu 16000000] [--out bench.json]
+#                         bench.ihx name ...
+#
+# Stops the simulator at bench_done() (address from the SDCC map file next to the
+# .ihx), dumps bench_cycles[] from XRAM 0x0000 and names the entries in order. The
+# first entry is the cost of the measurement and is subtracted from the others.
+#
+# All counts are machine cycles of the simulated 8052 core (12 clocks each), not
+# CH55x cycles, and there is no time field: they track regressions between builds,
+# not hardware timing. Names of the form DLY_us(n) also get the cycles DLY_us()
+# aims for at --fcpu and the difference. DLY_us() counts the same simulated Timer2,
+# so that difference shows its DLY_US_OVERHEAD on this core, not its accuracy on a
+# CH55x.
+
+import argparse
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+
+BREAK = '_bench_done'
+CORE = 's51 -t 8052 machine cycles'
+
+
+def symbol_address(map_file, name):
+    with open(map_file) as f:
+        for line in f:
+            m = re.search(r'\b([0-9A-Fa-f]{4,8})\s+' + name + r'\b', line)
+            if m:
+                return int(m.group(1), 16)
+    sys.exit('%s: %s not found' % (map_file, name))
+
+
+def run_s51(s51, ihx, address, size, timeout):
+    commands = 'break 0x%04x\nrun\ndump xram 0x0000 0x%04x\nkill\n' % (address, size - 1)
+    try:
+        out = subprocess.run(shlex.split(s51) + ['-t', '8052', ihx], input=commands,
+                             capture_output=True, text=True, timeout=timeout).stdout
+    except FileNotFoundError:
+        sys.exit('%s not found, install ucsim (part of SDCC) or set S51' % s51)
+    except subprocess.TimeoutExpired:
+        sys.exit('%s did not reach %s within %us' % (s51, BREAK, timeout))
+    data = {}
+    for line in out.splitlines():
+        m = re.match(r'^(?:\d*>\s*)*(?:0x)?([0-9A-Fa-f]{4,8})((?:\s+[0-9A-Fa-f]{2}\b)+)', line)
+        if m:
+            addr = int(m.group(1), 16)
+            for i, b in enumerate(m.group(2).split()):
+                data[addr + i] = int(b, 16)
+    if any(a not in data for a in range(size)):
+        sys.exit('no XRAM dump in the output of %s:\n%s' % (s51, out))
+    return bytes(data[a] for a in range(size))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='run a bench firmware in ucsim')
+    parser.add_argument('--s51', default='s51', help='simulator command')
+    parser.add_argument('--fcpu', type=int, default=16000000, help='F_CPU in Hz')
+    parser.add_argument('--timeout', type=int, default=60, help='seconds')
+    parser.add_argument('--out', help='also write the JSON to this file')
+    parser.add_argument('ihx')
+    parser.add_argument('names', nargs='+')
+    args = parser.parse_args()
+
+    address = symbol_address(os.path.splitext(args.ihx)[0] + '.map', BREAK)
+    raw = run_s51(args.s51, args.ihx, address, 4 * len(args.names), args.timeout)
+    cycles = [int.from_bytes(raw[4 * i:4 * i + 4], 'little') for i in range(len(args.names))]
+
+    overhead = cycles[0]
+    benches = []
+    for name, c in zip(args.names[1:], cycles[1:]):
+        c = max(c - overhead, 0)
+        bench = {'name': name, 'core': CORE, 'cycles': c}
+        m = re.match(r'DLY_us\((\d+)\)$', name)
+        if m:
+            want = int(m.group(1)) * args.fcpu // 1000000
+            bench['target_cycles'] = want
+            bench['target_diff_cycles'] = c - want
+        benches.append(bench)
+
+    report = json.dumps({'core': CORE, 'f_cpu': args.fcpu,
+                         'overhead_cycles': overhead, 'benches': benches}, indent=2)
+    print(report)
+    if args.out:
+        with open(args.out, 'w') as f:
+            f.write(report + '\n')
+
+
+if __name__ == '__main__':
+    main()
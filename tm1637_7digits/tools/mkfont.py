@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# ===================================================================================
+# Generate the 7-segment lookup table of the TM1637 driver
+# ===================================================================================
+#
+# Usage: python3 mkfont.py font7seg.txt > ../src/font7seg.h
+#
+# Reads the readable font description (see font7seg.txt) and writes a C header
+# with a 256 entry __code table indexed directly by the character code.
+
+import sys
+
+SEGMENTS = {'a': 0x01, 'b': 0x02, 'c': 0x04, 'd': 0x08,
+            'e': 0x10, 'f': 0x20, 'g': 0x40, 'p': 0x80}
+
+
+def parse_char(token, where):
+    if len(token) == 3 and token[0] == "'" and token[2] == "'":
+        return ord(token[1])
+    if token.lower().startswith('0x'):
+        return int(token, 16)
+    sys.exit('%s: invalid character %s' % (where, token))
+
+
+def parse_segments(token, where):
+    if token == '-':
+        return 0
+    value = 0
+    for c in token:
+        if c not in SEGMENTS:
+            sys.exit('%s: invalid segment %s' % (where, c))
+        value |= SEGMENTS[c]
+    return value
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: mkfont.py <font description>')
+    table = [0] * 256
+    listed = set()
+    with open(sys.argv[1], encoding='latin-1') as f:
+        for num, line in enumerate(f, 1):
+            where = '%s:%d' % (sys.argv[1], num)
+            line = line.rstrip('\n')
+            if not line.strip() or line.startswith('#'):
+                continue
+            # the character token may itself be a space or a quote: 'x'
+            if line.startswith("'"):
+                token, rest = line[:3], line[3:]
+            else:
+                token, _, rest = line.partition(' ')
+            code = parse_char(token, where)
+            if code > 255:
+                sys.exit('%s: character code out of range' % where)
+            table[code] = parse_segments(rest.strip(), where)
+            listed.add(code)
+
+    # uppercase letters default to the lowercase glyphs
+    for code in range(ord('A'), ord('Z') + 1):
+        if code not in listed:
+            table[code] = table[code + 32]
+
+    out = sys.stdout
+    out.write('// ===================================================================================\n')
+    out.write('// 7-Segment Font for the TM1637 Driver\n')
+    out.write('// ===================================================================================\n')
+    out.write('//\n')
+    out.write('// Generated by tools/mkfont.py from tools/font7seg.txt - do not edit.\n')
+    out.write('// Bit 0..6 = segment a..g, bit 7 = decimal point / colon. Indexed by the byte of\n')
+    out.write('// the character: the degree sign is Latin-1 0xB0, write it as \\xB0 (a UTF-8 degree\n')
+    out.write('// sign in a string literal is the two bytes 0xC2 0xB0). Included by tm1637plus.c\n')
+    out.write('// only, the table is static.\n\n')
+    out.write('#pragma once\n')
+    out.write('#include <stdint.h>\n\n')
+    out.write('static __code const uint8_t FONT7SEG[256] = {\n')
+    for row in range(0, 256, 16):
+        values = ', '.join('0x%02X' % v for v in table[row:row + 16])
+        out.write('    %s, // 0x%02X\n' % (values, row))
+    out.write('};\n')
+
+
+if __name__ == '__main__':
+    main()